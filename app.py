@@ -1,11 +1,23 @@
 import streamlit as st
 import pandas as pd
 import os
+import math
 import altair as alt
 
+from compare import parse_jsonl
+from fit import fit_series, crossovers
+
 def process_dat_file(file_path):
     """Read and process a single .dat file"""
+    # columns are named by the header line; harness runs (eval -w/-r) report
+    # the median as the time, and counters (eval -p) add more columns
     column_names = ['Fibonacci index', 'Time (s)', 'Size (bytes)']
+    with open(file_path) as f:
+        for line in f:
+            if line.startswith('#') and '|' in line:
+                column_names = [name.strip() for name in line.lstrip('#').split('|')]
+                break
+    column_names = ['Time (s)' if name == 'Median (s)' else name for name in column_names]
     
     df = pd.read_csv(
         file_path,
@@ -16,24 +28,57 @@ def process_dat_file(file_path):
         names=column_names
     )
     
-    df['Time (s)'] = df['Time (s)'].str.replace('s', '').astype(float)
-    df['Size (bytes)'] = df['Size (bytes)'].str.replace('B', '').astype(int)
+    # strip the units; counters that were unavailable ('-') become NaN
+    for column in column_names[1:]:
+        df[column] = pd.to_numeric(
+            df[column].astype(str).str.strip().str.rstrip('sB%').str.strip(),
+            errors='coerce'
+        )
     return df
 
+def process_jsonl_file(file_path):
+    """Read the results of eval -J or bench -J, one DataFrame per impl"""
+    _, rows = parse_jsonl(file_path)
+    df = pd.DataFrame(rows, columns=['Method', 'Fibonacci index', 'Time (s)'])
+    return [group for _, group in df.groupby('Method')]
+
+def fitted_lines(df):
+    """Piecewise power laws per method (fit.py), sampled for drawing, and the
+    crossovers between them"""
+    fits = {}
+    lines = []
+    for method, group in df.groupby('Method'):
+        fit, _ = fit_series(dict(zip(group['Fibonacci index'], group['Time (s)'])))
+        if fit is None:
+            continue
+        fits[method] = fit
+        for k in range(101):
+            index = math.exp(fit.low + (fit.high - fit.low) * k / 100)
+            lines.append({'Method': method, 'Fibonacci index': index, 'Time (s)': fit.time(index)})
+    crossed = pd.DataFrame(
+        [{'Crossover': '%s overtakes %s' % (winner, loser), 'Fibonacci index': index}
+         for loser, winner, index, _, _, _ in crossovers(fits)],
+        columns=['Crossover', 'Fibonacci index'])
+    return fits, pd.DataFrame(lines), crossed
+
 def main():
     st.title('Fibonacci V2')
     
     data_folder = 'data'
-    dat_files = [f for f in os.listdir(data_folder) if f.endswith('.dat')]
+    dat_files = [f for f in os.listdir(data_folder)
+                 if f.endswith('.jsonl') or (f.endswith('.dat') and not f.endswith('.ops.dat'))]
     
     if not dat_files:
-        st.error("No .dat files found!")
+        st.error("No .dat or .jsonl files found!")
         return
 
     # Process all files and combine into a single DataFrame
     all_data = []
     for file in dat_files:
         file_path = os.path.join(data_folder, file)
+        if file.endswith('.jsonl'):
+            all_data.extend(process_jsonl_file(file_path))
+            continue
         df = process_dat_file(file_path)
         method = os.path.splitext(file)[0]
         df['Method'] = method  # Add method column for coloring
@@ -55,21 +100,52 @@ def main():
     # Filter data based on selected methods
     filtered_df = combined_df[combined_df['Method'].isin(selected_methods)]
     
+    # log-log, so the small indices are not flattened and a power law is a
+    # straight line; index 0 and times of 0 have no place on it
+    log_scale = st.sidebar.checkbox("Log-log axes", value=True)
+    show_fits = st.sidebar.checkbox("Fitted power laws and crossovers", value=True)
+    if log_scale:
+        filtered_df = filtered_df[(filtered_df['Fibonacci index'] > 0) & (filtered_df['Time (s)'] > 0)]
+    scale = alt.Scale(type='log') if log_scale else alt.Scale(type='linear')
+
     # Create time comparison chart with smaller points
     time_chart = alt.Chart(filtered_df).mark_line(
         point=alt.OverlayMarkDef(shape='circle', size=2)  # Reduced size from 30 to 10
     ).encode(
-        x=alt.X('Fibonacci index:Q', title='Fibonacci Index'),
-        y=alt.Y('Time (s):Q', title='Time (s)'),  # Removed logarithmic scale
+        x=alt.X('Fibonacci index:Q', title='Fibonacci Index', scale=scale),
+        y=alt.Y('Time (s):Q', title='Time (s)', scale=scale),
         color='Method:N',
         tooltip=['Method', 'Fibonacci index', 'Time (s)']
-    ).properties(
+    )
+
+    chart = time_chart
+    if show_fits:
+        fits, lines, crossed = fitted_lines(filtered_df)
+        if not lines.empty:
+            fit_chart = alt.Chart(lines).mark_line(strokeDash=[4, 4], opacity=0.7).encode(
+                x=alt.X('Fibonacci index:Q', scale=scale),
+                y=alt.Y('Time (s):Q', scale=scale),
+                color='Method:N'
+            )
+            rules = alt.Chart(crossed).mark_rule(color='gray', opacity=0.5).encode(
+                x=alt.X('Fibonacci index:Q', scale=scale),
+                tooltip=['Crossover', 'Fibonacci index']
+            )
+            chart = time_chart + fit_chart + rules
+
+    st.altair_chart(chart.properties(
         title='',
         width=800,
         height=300
-    ).interactive()  # Enable zoom and pan
-    
-    st.altair_chart(time_chart)
+    ).interactive())  # Enable zoom and pan
+
+    if show_fits and fits:
+        st.subheader('Fitted exponents (time ~ index^e, per segment)')
+        st.dataframe(pd.DataFrame(
+            [{'Method': method, 'First index': round(first), 'Last index': round(last), 'Exponent': exponent}
+             for method, fit in sorted(fits.items()) for first, last, exponent in fit.segments()]))
+        st.subheader('Crossovers')
+        st.dataframe(crossed)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,125 @@
+#include "fib_pool.h"
+
+#include <gmp.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static double elapsed(struct timespec const *start, struct timespec const *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    // [-j workers] index...  (indices from stdin if there are none)
+    unsigned nworkers = 0;
+    int first_arg = 1;
+    if (argc > 2 && !strcmp(argv[1], "-j"))
+    {
+        nworkers = strtoul(argv[2], NULL, 10);
+        first_arg = 3;
+    }
+
+    size_t count = 0, capacity = 64;
+    uint64_t *indices = malloc(capacity * sizeof(*indices));
+    char buf[32];
+    for (int i = first_arg; argc == first_arg || i < argc; ++i)
+    {
+        char const *arg = argv[i];
+        if (argc == first_arg)
+        {
+            if (scanf("%31s", buf) != 1) { break; }
+            arg = buf;
+        }
+
+        char *endptr;
+        unsigned long long index = strtoull(arg, &endptr, 10);
+        if (*endptr != '\0')
+        {
+            fprintf(stderr, "Failed to interpret %s as an integer.\n", arg);
+            return EXIT_FAILURE;
+        }
+        if (count == capacity)
+        {
+            capacity *= 2;
+            indices = realloc(indices, capacity * sizeof(*indices));
+        }
+        indices[count++] = index;
+    }
+
+    int efd = eventfd(0, 0);
+    if (efd < 0 || fib_pool_start(nworkers))
+    {
+        fprintf(stderr, "Failed to start the worker pool.\n");
+        return EXIT_FAILURE;
+    }
+
+    struct fib_request *requests = calloc(count ? count : 1, sizeof(*requests));
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    for (size_t i = 0; i < count; ++i)
+    {
+        requests[i].index = indices[i];
+        requests[i].eventfd = efd;
+        fibonacci_submit(&requests[i]);
+    }
+    for (uint64_t done = 0; done < count;)
+    {
+        uint64_t completed;
+        if (read(efd, &completed, sizeof(completed)) == sizeof(completed))
+        {
+            done += completed;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    fib_pool_stop();
+
+    // checked against mpz_fib_ui(), not the impl: a wrong result may come
+    // from state the impl keeps between calls, and fibonacci() would agree
+    size_t nwrong = 0;
+    mpz_t reference;
+    mpz_init(reference);
+    for (size_t i = 0; i < count; ++i)
+    {
+        mpz_fib_ui(reference, indices[i]);
+        struct number expected = { NULL, 0 };
+        expected.bytes = mpz_export(NULL, &expected.length, -1, 1, 0, 0, reference);
+        struct number const *actual = &requests[i].result;
+
+        // compare up to the shorter length, the rest must be zero padding
+        size_t const common = expected.length < actual->length ? expected.length : actual->length;
+        int same = !common || !memcmp(expected.bytes, actual->bytes, common);
+        for (size_t j = common; j < expected.length; ++j)
+        {
+            same &= !((uint8_t *)expected.bytes)[j];
+        }
+        for (size_t j = common; j < actual->length; ++j)
+        {
+            same &= !((uint8_t *)actual->bytes)[j];
+        }
+        if (!same)
+        {
+            fprintf(stderr, "Async F(%llu) differs from mpz_fib_ui().\n",
+                (long long unsigned)indices[i]);
+            ++nwrong;
+        }
+        free(expected.bytes);
+        free(actual->bytes);
+    }
+    mpz_clear(reference);
+
+    fprintf(stderr,
+        "# Indices: %llu (%llu wrong)\n"
+        "# Wall:    %.9fs\n",
+        (long long unsigned)count,
+        (long long unsigned)nwrong,
+        elapsed(&start_time, &end_time)
+    );
+
+    close(efd);
+    free(requests);
+    free(indices);
+    return nwrong ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include "fib_base.h"
+#include "fib_lockstep.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef CLOCK
+#   define CLOCK CLOCK_PROCESS_CPUTIME_ID
+#endif
+
+static double elapsed(struct timespec const *start, struct timespec const *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// compares two results, ignoring zero padding above the shorter one
+static int same_number(struct number const *lhs, struct number const *rhs)
+{
+    uint8_t const *a = lhs->bytes;
+    uint8_t const *b = rhs->bytes;
+    size_t const common = lhs->length < rhs->length ? lhs->length : rhs->length;
+    if (memcmp(a, b, common))
+    {
+        return 0;
+    }
+    for (size_t i = common; i < lhs->length; ++i)
+    {
+        if (a[i]) { return 0; }
+    }
+    for (size_t i = common; i < rhs->length; ++i)
+    {
+        if (b[i]) { return 0; }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    // indices come from the command line, or from stdin if there are none
+    size_t count = 0, capacity = argc > 1 ? argc - 1 : 64;
+    uint64_t *indices = malloc(capacity * sizeof(*indices));
+    char buf[32];
+    for (int i = 1; argc == 1 || i < argc; ++i)
+    {
+        char const *arg = argv[i];
+        if (argc == 1)
+        {
+            if (scanf("%31s", buf) != 1) { break; }
+            arg = buf;
+        }
+
+        char *endptr;
+        unsigned long long index = strtoull(arg, &endptr, 10);
+        if (*endptr != '\0')
+        {
+            fprintf(stderr, "Failed to interpret %s as an integer.\n", arg);
+            return EXIT_FAILURE;
+        }
+        if (count == capacity)
+        {
+            capacity *= 2;
+            indices = realloc(indices, capacity * sizeof(*indices));
+        }
+        indices[count++] = index;
+    }
+
+    struct number *batched = calloc(count ? count : 1, sizeof(*batched));
+    struct number *single = calloc(count ? count : 1, sizeof(*single));
+    struct number *lockstep = calloc(count ? count : 1, sizeof(*lockstep));
+
+    struct timespec start_time, mid_time, end_time, lockstep_time;
+    clock_gettime(CLOCK, &start_time);
+    fibonacci_many(indices, count, batched);
+    clock_gettime(CLOCK, &mid_time);
+    for (size_t i = 0; i < count; ++i)
+    {
+        single[i] = fibonacci(indices[i]);
+    }
+    clock_gettime(CLOCK, &end_time);
+    fibonacci_lockstep(indices, count, lockstep);
+    clock_gettime(CLOCK, &lockstep_time);
+
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!same_number(&batched[i], &single[i]))
+        {
+            fprintf(stderr, "Batched F(%llu) differs from fibonacci().\n",
+                (long long unsigned)indices[i]);
+            status = EXIT_FAILURE;
+        }
+        if (!same_number(&lockstep[i], &single[i]))
+        {
+            fprintf(stderr, "Lockstep F(%llu) differs from fibonacci().\n",
+                (long long unsigned)indices[i]);
+            status = EXIT_FAILURE;
+        }
+        free(batched[i].bytes);
+        free(single[i].bytes);
+        free(lockstep[i].bytes);
+    }
+
+    fprintf(stderr,
+        "# Indices: %llu\n"
+        "# Batched: %.9fs\n"
+        "# Single:  %.9fs\n"
+        "# Lockstep (%u lanes): %.9fs\n",
+        (long long unsigned)count,
+        elapsed(&start_time, &mid_time),
+        elapsed(&mid_time, &end_time),
+        fib_lockstep_lanes, elapsed(&end_time, &lockstep_time)
+    );
+
+    free(batched);
+    free(single);
+    free(lockstep);
+    free(indices);
+    return status;
+}
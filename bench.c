@@ -0,0 +1,472 @@
+#define _GNU_SOURCE
+#include "fib_base.h"
+#include "fib_control.h"
+#include "fib_registry.h"
+#include "fib_results.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// All impls in one binary, for A/B comparisons under the same conditions.
+//
+// The impls come from fib_registry.h. For each index, the selected impls
+// take turns (warmup runs first, then the timed runs in an order rotated
+// every repetition), so drift in clock speed or cache state hits all of
+// them alike. Every result is checked against the mpz_fib_ui() baseline.
+// An impl drops out once its median exceeds the cutoff, or it fails.
+//
+// With -a dir, each impl instead runs alone in a child process pinned to a
+// core of its own (as many at a time as there are cores, the first one
+// left to the system when there are several), writing dir/<name>.dat in
+// eval's harness format.
+//
+// With -J, results are JSON lines instead (fib_results.h), every row named
+// after its impl, and -a writes dir/<name>.jsonl.
+//
+// Times are wall-clock, so impls using helper threads are not flattered.
+
+#define THREAD_TIMEOUT_SEC 5
+#define DEFAULT_CUTOFF 1.0
+#define DEFAULT_WARMUP 1
+#define DEFAULT_REPS 5
+#define MAX_REPS 1024
+#define MAX_IMPLS 64
+#define MAX_INDICES 4096
+
+struct options {
+    unsigned warmup;
+    unsigned reps;
+    double cutoff;                  // seconds
+    int cpu;                        // -1: not pinned
+    unsigned jobs;                  // -a: 0 for one per core
+    char const *data_dir;           // -a
+    int json;                       // -J
+};
+
+struct stats {
+    double median;
+    double minimum;
+    double p90;
+    double spread;                  // interquartile range over median, in %
+    size_t length;
+};
+
+static size_t significant_length(struct number n)
+{
+    uint8_t const *bytes = n.bytes;
+    size_t length = n.length;
+    while (length && !bytes[length - 1])
+    {
+        --length;
+    }
+    return length;
+}
+
+static int same_value(struct number a, struct number b)
+{
+    size_t const length = significant_length(a);
+    return length == significant_length(b) && !memcmp(a.bytes, b.bytes, length);
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Runs impl once; returns the wall time in seconds, or a negative value if
+// it was cancelled or got the wrong result.
+static double run_once(struct fib_impl const *impl, uint64_t index, struct number expected)
+{
+    struct fib_control control = { .cancel = 0 };
+    clock_gettime(CLOCK_MONOTONIC, &control.deadline);
+    control.deadline.tv_sec += THREAD_TIMEOUT_SEC;
+
+    fib_control_attach(&control);
+    double const start = now();
+    struct number result = impl->fibonacci(index);
+    double const elapsed = now() - start;
+    fib_control_attach(NULL);
+
+    if (!result.bytes)
+    {
+        fprintf(stderr, "# %s: F(%llu) cancelled\n", impl->name, (long long unsigned)index);
+        return -1;
+    }
+    int const correct = same_value(result, expected);
+    free(result.bytes);
+    if (!correct)
+    {
+        fprintf(stderr, "# %s: wrong result for F(%llu)\n", impl->name, (long long unsigned)index);
+        return -1;
+    }
+    return elapsed;
+}
+
+static int compare_double(void const *lhs, void const *rhs)
+{
+    double const a = *(double const *)lhs, b = *(double const *)rhs;
+    return (a > b) - (a < b);
+}
+
+// nearest-rank quantile of sorted[0, n)
+static double quantile(double const *sorted, unsigned n, double q)
+{
+    unsigned rank = (unsigned)(q * n + 0.999999);
+    if (rank < 1) { rank = 1; }
+    if (rank > n) { rank = n; }
+    return sorted[rank - 1];
+}
+
+static struct stats summarize(double *times, unsigned n, size_t length)
+{
+    qsort(times, n, sizeof(times[0]), compare_double);
+    struct stats s = {
+        .median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2,
+        .minimum = times[0],
+        .p90 = quantile(times, n, 0.9),
+        .length = length,
+    };
+    s.spread = s.median > 0
+        ? 100 * (quantile(times, n, 0.75) - quantile(times, n, 0.25)) / s.median
+        : 0;
+    return s;
+}
+
+static void print_header(FILE *out, int with_name)
+{
+    fprintf(out, "#   Fibonacci index  |%s  Median (s)  |   Min (s)    |   p90 (s)    | IQR/med | Size (bytes) \n"
+                 "# -------------------+%s--------------+--------------+--------------+---------+--------------\n",
+        with_name ? " Implementation |" : "",
+        with_name ? "----------------+" : "");
+}
+
+static void print_json_header(FILE *out, struct options const *options)
+{
+    fib_results_meta(out, "bench");
+    fprintf(out, ",\"clock\":\"wall\",\"warmup\":%u,\"reps\":%u,\"cutoff_s\":%g,\"pinned_cpu\":%d}\n",
+        options->warmup, options->reps, options->cutoff, options->cpu);
+}
+
+// times[0, n) are the timed runs, sorted by summarize()
+static void print_json_row(FILE *out, uint64_t index, char const *name, struct stats const *s,
+                           double const *times, unsigned n)
+{
+    fputs("{\"type\":\"result\",\"impl\":", out);
+    fib_results_string(out, name);
+    fprintf(out, ",\"index\":%llu,\"time_s\":%.9f,\"min_s\":%.9f,\"p90_s\":%.9f,\"iqr_pct\":%.2f,\"size_bytes\":%llu",
+        (long long unsigned)index, s->median, s->minimum, s->p90, s->spread, (long long unsigned)s->length);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        fprintf(out, "%s%.9f", i ? "," : ",\"samples_s\":[", times[i]);
+    }
+    fputs(n ? "]}\n" : "}\n", out);
+    fflush(out);
+}
+
+static void print_row(FILE *out, uint64_t index, char const *name, struct stats const *s)
+{
+    fprintf(out, "%20llu | ", (long long unsigned)index);
+    if (name)
+    {
+        fprintf(out, "%-14s | ", name);
+    }
+    fprintf(out, "%.9fs | %.9fs | %.9fs | %6.2f%% | %llu B\n",
+        s->median, s->minimum, s->p90, s->spread, (long long unsigned)s->length);
+    fflush(out);
+}
+
+// Times impls[0, n) on the given indices, or on a geometric sweep from 0 if
+// there are none, until all of them have dropped out. Rows go to out, with
+// the impl name unless there is a single impl.
+static void sweep(struct fib_impl const *const *impls, unsigned n,
+                  uint64_t const *indices, size_t nindices,
+                  struct options const *options, FILE *out)
+{
+    static double times[MAX_IMPLS][MAX_REPS];
+    int active[MAX_IMPLS];
+    unsigned nactive = n;
+    for (unsigned j = 0; j < n; ++j)
+    {
+        active[j] = 1;
+    }
+
+    if (options->json)
+    {
+        print_json_header(out, options);
+    }
+    else
+    {
+        print_header(out, n > 1);
+    }
+
+    uint64_t index = 0;
+    for (size_t k = 0; nactive && (nindices == 0 || k < nindices); ++k)
+    {
+        if (nindices)
+        {
+            index = indices[k];
+        }
+        else if (k)
+        {
+            uint64_t const step = (index >> 1) - (index >> 3);
+            index += step ? step : 1;
+        }
+
+        struct number const expected = fib_registry[0].fibonacci(index);
+
+        for (unsigned j = 0; j < n; ++j)
+        {
+            for (unsigned w = 0; active[j] && w < options->warmup; ++w)
+            {
+                double const t = run_once(impls[j], index, expected);
+                if (t < 0)
+                {
+                    active[j] = 0;
+                    --nactive;
+                }
+            }
+        }
+
+        // rotated every repetition, so no impl always runs first
+        for (unsigned r = 0; r < options->reps; ++r)
+        {
+            for (unsigned i = 0; i < n; ++i)
+            {
+                unsigned const j = (i + r) % n;
+                if (!active[j])
+                {
+                    continue;
+                }
+                times[j][r] = run_once(impls[j], index, expected);
+                if (times[j][r] < 0)
+                {
+                    active[j] = 0;
+                    --nactive;
+                }
+            }
+        }
+
+        for (unsigned j = 0; j < n; ++j)
+        {
+            if (!active[j])
+            {
+                continue;
+            }
+            struct stats const s = summarize(times[j], options->reps, significant_length(expected));
+            if (options->json)
+            {
+                print_json_row(out, index, impls[j]->name, &s, times[j], options->reps);
+            }
+            else
+            {
+                print_row(out, index, n > 1 ? impls[j]->name : NULL, &s);
+            }
+            if (s.median > options->cutoff)
+            {
+                fprintf(stderr, "# %s: past the cutoff at F(%llu)\n", impls[j]->name, (long long unsigned)index);
+                active[j] = 0;
+                --nactive;
+            }
+        }
+        free(expected.bytes);
+    }
+}
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set))
+    {
+        perror("sched_setaffinity");
+    }
+}
+
+// -a: every impl alone in a child of its own, one per core
+static int all_data(struct fib_impl const *const *impls, unsigned n,
+                    uint64_t const *indices, size_t nindices,
+                    struct options const *options)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    int cpus[CPU_SETSIZE];
+    unsigned ncpus = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpus[ncpus++] = cpu;
+        }
+    }
+    // the first core takes the interrupts and the rest of the system
+    unsigned first = ncpus > 2 ? 1 : 0;
+    unsigned slots = ncpus - first;
+    if (options->jobs && options->jobs < slots)
+    {
+        slots = options->jobs;
+    }
+
+    if (slots == 0)
+    {
+        slots = 1;
+    }
+
+    pid_t running[CPU_SETSIZE] = { 0 };
+    unsigned next = 0, nrunning = 0;
+    int status = EXIT_SUCCESS;
+    while (next < n || nrunning)
+    {
+        if (next < n && nrunning < slots)
+        {
+            unsigned slot = 0;
+            while (running[slot])
+            {
+                ++slot;
+            }
+            struct fib_impl const *impl = impls[next++];
+            int const cpu = cpus[first + slot];
+
+            fprintf(stderr, "# %s on cpu %d\n", impl->name, cpu);
+            fflush(NULL);
+            pid_t const pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                status = EXIT_FAILURE;
+                break;
+            }
+            if (pid == 0)
+            {
+                // helper threads would leave the core
+                setenv("FIB_WORKERS", "0", 0);
+                pin(cpu);
+
+                char path[4096];
+                snprintf(path, sizeof(path), "%s/%s.%s", options->data_dir, impl->name,
+                    options->json ? "jsonl" : "dat");
+                FILE *out = fopen(path, "w");
+                if (!out)
+                {
+                    perror(path);
+                    _exit(EXIT_FAILURE);
+                }
+                sweep(&impl, 1, indices, nindices, options, out);
+                _exit(fclose(out) ? EXIT_FAILURE : EXIT_SUCCESS);
+            }
+            running[slot] = pid;
+            ++nrunning;
+            continue;
+        }
+
+        int child_status;
+        pid_t const pid = wait(&child_status);
+        if (pid < 0)
+        {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != EXIT_SUCCESS)
+        {
+            status = EXIT_FAILURE;
+        }
+        for (unsigned slot = 0; slot < slots; ++slot)
+        {
+            if (running[slot] == pid)
+            {
+                running[slot] = 0;
+                --nrunning;
+            }
+        }
+    }
+    while (nrunning && wait(NULL) > 0)
+    {
+        --nrunning;
+    }
+    return status;
+}
+
+static void usage(char const *argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [-i impl,...] [-w warmup] [-r reps] [-t cutoff_s] [-c cpu]\n"
+        "       %*s [-a data_dir [-j jobs]] [-J] [index...]\n"
+        "Implementations:",
+        argv0, (int)strlen(argv0), "");
+    fputc(' ', stderr);
+    fib_registry_list(stderr);
+    fputc('\n', stderr);
+}
+
+int main(int argc, char *argv[])
+{
+    struct options options = {
+        .warmup = DEFAULT_WARMUP,
+        .reps = DEFAULT_REPS,
+        .cutoff = DEFAULT_CUTOFF,
+        .cpu = -1,
+        .jobs = 0,
+        .data_dir = NULL,
+        .json = 0,
+    };
+    char *selection = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:w:r:t:c:a:j:J")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': selection = optarg; break;
+            case 'w': options.warmup = strtoul(optarg, NULL, 0); break;
+            case 'r': options.reps = strtoul(optarg, NULL, 0); break;
+            case 't': options.cutoff = strtod(optarg, NULL); break;
+            case 'c': options.cpu = atoi(optarg); break;
+            case 'a': options.data_dir = optarg; break;
+            case 'j': options.jobs = strtoul(optarg, NULL, 0); break;
+            case 'J': options.json = 1; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (options.reps == 0 || options.reps > MAX_REPS)
+    {
+        fprintf(stderr, "reps must be between 1 and %d\n", MAX_REPS);
+        return EXIT_FAILURE;
+    }
+
+    struct fib_impl const *impls[MAX_IMPLS];
+    unsigned const n = fib_registry_select(selection, impls, MAX_IMPLS);
+    if (n == 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static uint64_t indices[MAX_INDICES];
+    size_t nindices = 0;
+    for (int i = optind; i < argc && nindices < MAX_INDICES; ++i)
+    {
+        indices[nindices++] = strtoull(argv[i], NULL, 0);
+    }
+
+    if (options.data_dir)
+    {
+        return all_data(impls, n, indices, nindices, &options);
+    }
+
+    if (options.cpu >= 0)
+    {
+        pin(options.cpu);
+    }
+    sweep(impls, n, indices, nindices, &options, stdout);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,359 @@
+"""Compares two sets of benchmark results and flags the slowdowns.
+
+    python3 compare.py [-t threshold] [-a alpha] [-m min_indices] [--min-time s] base new
+    python3 compare.py --self-check
+
+base and new are results files or directories of them: the JSON lines of
+`eval -J` and `bench -J` (fib_results.h), or the .dat tables of eval and
+bench, named after the impl they hold. Results are aligned by impl and
+index. Where the two runs sampled different indices (eval's last sweep
+steps by how far the run got), the new runs of the nearest index are
+scaled to the time interpolated log-log at the base index, within the
+range the new run covered.
+
+Each impl is compared per decade of the index, on the timed runs of every
+index (samples_s; the .dat tables and runs without repetitions have only
+the median, one run per index). In a band, the runs are ranked per index,
+and the rank sums of the new runs are combined over the indices of the
+band (van Elteren's stratified Wilcoxon test, one-sided, normal
+approximation), so the noise of each index is measured against its own
+repetitions. Indices whose base median is under --min-time (1 µs) are
+left out, as fit.py does: there the clock reads are most of what is
+timed. The p-values of the bands of an impl are Holm-adjusted. A band is
+a slowdown if its median ratio of the medians new/base exceeds
+1 + threshold and its adjusted p-value is below alpha; faster bands are
+reported the same way. The exit status is 1 if there is any slowdown, so
+this can gate a build.
+
+--self-check runs the comparison on synthetic results, 4 impls over indices
+0 to 10^7, and fails unless a uniform 2x slowdown is flagged in every impl
+and a rerun of the same distribution is flagged nowhere.
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import sys
+
+
+def parse_dat(path):
+    """Rows of an eval or bench table, as (impl, index, seconds)."""
+    stem = os.path.basename(path).split('.')[0]
+    names = None
+    rows = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                if names is None and '|' in line:
+                    names = [name.strip() for name in line.lstrip('#').split('|')]
+                continue
+            fields = [field.strip() for field in line.split('|')]
+            if len(fields) < 2 or not fields[0].isdigit():
+                continue
+            named = dict(zip(names or [], fields))
+            impl = named.get('Implementation', stem)
+            time = named.get('Median (s)', named.get('Time (s)', fields[1]))
+            rows.append((impl, int(fields[0]), float(time.rstrip('s'))))
+    return rows
+
+
+def parse_jsonl(path, runs=False):
+    """The metadata and the (impl, index, seconds) rows of a JSON lines file,
+    or with runs, (impl, index, [seconds of every timed run])."""
+    meta = None
+    rows = []
+    with open(path) as f:
+        for line in f:
+            if not line.strip():
+                continue
+            try:
+                record = json.loads(line)
+            except ValueError:
+                # the last line of a run that was killed
+                print('# %s: skipped a malformed line' % path)
+                continue
+            if record.get('type') == 'meta':
+                meta = record
+            elif record.get('type') == 'result':
+                seconds = record['time_s']
+                if runs:
+                    seconds = record.get('samples_s') or [seconds]
+                rows.append((record['impl'], record['index'], seconds))
+    return meta, rows
+
+
+def load(path, runs=False):
+    """Metadata and {impl: {index: seconds}} of a file or a directory, or with
+    runs, {impl: {index: [seconds of every timed run]}}."""
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, name) for name in os.listdir(path))
+        jsonl = {os.path.basename(f).split('.')[0] for f in files if f.endswith('.jsonl')}
+        # a .dat of an impl that also has JSON results is the older copy
+        files = [f for f in files
+                 if f.endswith('.jsonl')
+                 or (f.endswith('.dat') and os.path.basename(f).split('.')[0] not in jsonl
+                     and not f.endswith('.ops.dat'))]
+    else:
+        files = [path]
+
+    metas = []
+    series = {}
+    for f in files:
+        if f.endswith('.jsonl'):
+            meta, rows = parse_jsonl(f, runs)
+            if meta:
+                metas.append(meta)
+        else:
+            rows = parse_dat(f)
+            if runs:
+                rows = [(impl, index, [seconds]) for impl, index, seconds in rows]
+        for impl, index, seconds in rows:
+            series.setdefault(impl, {})[index] = seconds
+    return metas, series
+
+
+def interpolate(points, index):
+    """Time at index from the sorted (index, seconds) points, log-log, or None
+    outside their range."""
+    lo, hi = 0, len(points) - 1
+    if not points or index < points[lo][0] or index > points[hi][0]:
+        return None
+    while hi - lo > 1:
+        mid = (lo + hi) // 2
+        if points[mid][0] <= index:
+            lo = mid
+        else:
+            hi = mid
+    (x0, y0), (x1, y1) = points[lo], points[hi]
+    if index == x0:
+        return y0
+    if index == x1 or y0 <= 0 or y1 <= 0:
+        return y1
+    t = (math.log(index + 1) - math.log(x0 + 1)) / (math.log(x1 + 1) - math.log(x0 + 1))
+    return math.exp(math.log(y0) + t * (math.log(y1) - math.log(y0)))
+
+
+def band_of(index):
+    return 0 if index < 10 else int(math.log10(index))
+
+
+def band_name(band):
+    return '0-9' if band == 0 else '1e%d-1e%d' % (band, band + 1)
+
+
+def ranks(values):
+    """Ranks of the values, 1-based, ties getting the average rank."""
+    order = sorted(range(len(values)), key=lambda i: values[i])
+    result = [0.0] * len(values)
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            result[order[k]] = (i + j) / 2 + 1
+        i = j + 1
+    return result
+
+
+def normal_sf(z):
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def rank_sum(base, new):
+    """W - E[W] and Var[W] of the rank sum W of the new runs among all the
+    runs of one index, ties getting the average rank."""
+    m, n = len(base), len(new)
+    total = m + n
+    r = ranks(base + new)
+    w = sum(r[m:])
+    ties = sum(r.count(rank) ** 3 - r.count(rank) for rank in set(r))
+    variance = m * n / 12 * ((total + 1) - ties / (total * (total - 1))) if total > 1 else 0.0
+    return w - n * (total + 1) / 2, variance
+
+
+def stratified(strata):
+    """One-sided p-values (slower, faster) of van Elteren's test of the new
+    runs against the base runs, over the strata [(base runs, new runs)]."""
+    statistic = variance = 0.0
+    for base, new in strata:
+        # weights 1/(N + 1), so every index counts alike whatever its runs
+        weight = 1 / (len(base) + len(new) + 1)
+        d, v = rank_sum(base, new)
+        statistic += weight * d
+        variance += weight * weight * v
+    if variance <= 0:
+        return 1.0, 1.0
+    z = statistic / math.sqrt(variance)
+    return normal_sf(z), normal_sf(-z)
+
+
+def holm(pvalues):
+    """Holm-adjusted p-values, in the same order."""
+    order = sorted(range(len(pvalues)), key=lambda i: pvalues[i])
+    adjusted = [1.0] * len(pvalues)
+    running = 0.0
+    for position, i in enumerate(order):
+        running = max(running, min(1.0, (len(pvalues) - position) * pvalues[i]))
+        adjusted[i] = running
+    return adjusted
+
+
+def median(values):
+    s = sorted(values)
+    n = len(s)
+    return s[n // 2] if n % 2 else (s[n // 2 - 1] + s[n // 2]) / 2
+
+
+def describe(metas):
+    if not metas:
+        return 'no metadata (.dat)'
+    m = metas[0]
+    return '%s, %s, %s, %s, %s' % (m.get('commit'), m.get('compiler'), m.get('cflags'),
+                                   m.get('cpu'), m.get('date'))
+
+
+def strata(base, new, min_time):
+    """(index, base runs, new runs) of the indices of base that new covers."""
+    points = sorted((index, median(runs)) for index, runs in new.items())
+    for index, runs in sorted(base.items()):
+        if median(runs) < min_time:
+            continue
+        other = new.get(index)
+        if other is None:
+            at = interpolate(points, index)
+            if at is None:
+                continue
+            near = min(new, key=lambda i: abs(math.log(i + 1) - math.log(index + 1)))
+            scale = at / median(new[near])
+            other = [x * scale for x in new[near]]
+        runs = [x for x in runs if x > 0]
+        other = [x for x in other if x > 0]
+        if runs and other:
+            yield index, runs, other
+
+
+def compare(base, new, threshold, alpha, min_indices, min_time):
+    """Prints the verdict per impl and band of the runs {impl: {index: [seconds]}}
+    of new against base; returns the (impl, band, verdict) rows."""
+    bands = []
+    for impl in sorted(set(base) & set(new)):
+        grouped = {}
+        for index, runs, other in strata(base[impl], new[impl], min_time):
+            grouped.setdefault(band_of(index), []).append((runs, other))
+        tested = {band: stratified(pairs) for band, pairs in grouped.items() if len(pairs) >= min_indices}
+        # per impl: a slowdown of one impl is not diluted by the bands of the others
+        order = sorted(tested)
+        greater = holm([tested[band][0] for band in order])
+        less = holm([tested[band][1] for band in order])
+        tested = {band: (g, l) for band, g, l in zip(order, greater, less)}
+        for band, pairs in sorted(grouped.items()):
+            bands.append((impl, band, pairs, tested.get(band)))
+
+    print('#     Implementation | Index band  | Indices |  Runs  | Median ratio | Geo. mean ratio | p slower | p faster | Verdict')
+    print('# -------------------+-------------+---------+--------+--------------+-----------------+----------+----------+----------')
+    rows = []
+    for impl, band, pairs, p in bands:
+        ratios = [median(other) / median(runs) for runs, other in pairs]
+        geo = math.exp(sum(math.log(x) for x in ratios) / len(ratios))
+        med = median(ratios)
+        nruns = sum(len(runs) + len(other) for runs, other in pairs)
+        if p is None:
+            p_slower = p_faster = '-'
+            verdict = 'too few'
+        else:
+            p_slower, p_faster = '%.4f' % p[0], '%.4f' % p[1]
+            verdict = 'same'
+            if med > 1 + threshold and p[0] < alpha:
+                verdict = 'SLOWER'
+            elif med < 1 - threshold and p[1] < alpha:
+                verdict = 'faster'
+        print('%20s | %-11s | %7d | %6d | %12.3f | %15.3f | %8s | %8s | %s'
+              % (impl, band_name(band), len(pairs), nruns, med, geo, p_slower, p_faster, verdict))
+        rows.append((impl, band, verdict))
+    return rows
+
+
+def synthetic(rng, impls, factor, reps=5, noise=0.05):
+    """Runs {impl: {index: [seconds]}} of impls over a geometric sweep of
+    0 to 10^7, as bench does it, each impl a power law times factor, with
+    lognormal noise."""
+    runs = {}
+    for k, impl in enumerate(impls):
+        exponent = 1 + 0.25 * k
+        index = 0
+        while index <= 10 ** 7:
+            base = factor * (2e-6 + 1e-9 * index ** exponent)
+            runs.setdefault(impl, {})[index] = [base * math.exp(rng.gauss(0, noise)) for _ in range(reps)]
+            step = (index >> 1) - (index >> 3)
+            index += step if step else 1
+    return runs
+
+
+def self_check(threshold, alpha, min_indices, min_time):
+    """Nonzero unless a 2x slowdown is flagged in every impl of synthetic
+    results, and a rerun without one is flagged nowhere."""
+    rng = random.Random(1)
+    impls = ['impl%d' % k for k in range(4)]
+    base = synthetic(rng, impls, 1)
+    failed = 0
+
+    print('# self-check: a uniform 2x slowdown')
+    rows = compare(base, synthetic(rng, impls, 2), threshold, alpha, min_indices, min_time)
+    for impl in impls:
+        if not any(i == impl and verdict == 'SLOWER' for i, _, verdict in rows):
+            print('# self-check failed: the slowdown of %s was not flagged' % impl)
+            failed = 1
+
+    print('# self-check: the same distribution again')
+    rows = compare(base, synthetic(rng, impls, 1), threshold, alpha, min_indices, min_time)
+    for impl, band, verdict in rows:
+        if verdict in ('SLOWER', 'faster'):
+            print('# self-check failed: %s %s flagged %s' % (impl, band_name(band), verdict))
+            failed = 1
+
+    print('# self-check %s' % ('failed' if failed else 'passed'))
+    return failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('base', nargs='?')
+    parser.add_argument('new', nargs='?')
+    parser.add_argument('-t', '--threshold', type=float, default=0.05,
+                        help='relative slowdown to flag (default 0.05)')
+    parser.add_argument('-a', '--alpha', type=float, default=0.05,
+                        help='significance level, after the Holm adjustment per impl (default 0.05)')
+    parser.add_argument('-m', '--min-indices', type=int, default=3,
+                        help='fewest indices a band needs to be tested (default 3)')
+    parser.add_argument('--min-time', type=float, default=1e-6,
+                        help='shortest base time compared, in seconds (default 1e-6)')
+    parser.add_argument('--self-check', action='store_true',
+                        help='check that a synthetic 2x slowdown is flagged, and nothing else')
+    args = parser.parse_args()
+
+    if args.self_check:
+        return self_check(args.threshold, args.alpha, args.min_indices, args.min_time)
+    if args.new is None:
+        parser.error('base and new are required')
+
+    base_meta, base = load(args.base, runs=True)
+    new_meta, new = load(args.new, runs=True)
+    print('# base: %s' % describe(base_meta))
+    print('# new:  %s' % describe(new_meta))
+    for key in ('compiler', 'cflags', 'cpu', 'host'):
+        if base_meta and new_meta and base_meta[0].get(key) != new_meta[0].get(key):
+            print('# warning: the runs differ in %s' % key)
+    for impl in sorted(set(base) ^ set(new)):
+        print('# %s is only in the %s results' % (impl, 'base' if impl in base else 'new'))
+
+    rows = compare(base, new, args.threshold, args.alpha, args.min_indices, args.min_time)
+    slowdowns = sum(verdict == 'SLOWER' for _, _, verdict in rows)
+    print('# %d slowdown%s' % (slowdowns, '' if slowdowns == 1 else 's'))
+    return 1 if slowdowns else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#include "fib_base.h"
+#include "fib_decimal.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef CLOCK
+#   define CLOCK CLOCK_PROCESS_CPUTIME_ID
+#endif
+
+static double elapsed(struct timespec const *start, struct timespec const *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s index [output.txt]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *endptr;
+    unsigned long long index = strtoull(argv[1], &endptr, 10);
+    if (*endptr != '\0')
+    {
+        fprintf(stderr, "Failed to interpret %s as an integer.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *output_file = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (output_file == NULL)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start_time, mid_time, end_time;
+    clock_gettime(CLOCK, &start_time);
+    struct number result = fibonacci(index);
+    clock_gettime(CLOCK, &mid_time);
+
+    // the conversion is threaded, so it is timed on the wall clock
+    struct timespec convert_start;
+    clock_gettime(CLOCK_MONOTONIC, &convert_start);
+    size_t length;
+    char *digits = fib_decimal(result, 0, &length);
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    fprintf(stderr,
+        "# Runtime: %.9fs\n"
+        "# Convert: %.9fs (wall)\n"
+        "# Digits:  %llu\n",
+        elapsed(&start_time, &mid_time),
+        elapsed(&convert_start, &end_time),
+        (long long unsigned)length
+    );
+
+    fwrite(digits, 1, length, output_file);
+    putc('\n', output_file);
+
+    free(digits);
+    free(result.bytes);
+    if (argc == 3)
+    {
+        fclose(output_file);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <math.h>
+#include "fib_base.h"
+#include "fib_dispatch.h"
+#include "fib_registry.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Drives fib_dispatch.h with a synthetic workload and prints what it
+// settled on.
+//
+// Indices are drawn log-uniformly from [1, max_index], so every regime gets
+// a similar share of the calls, and served one by one through the
+// dispatcher. Every report_every calls (and at the end), the decision table
+// goes to stdout; in between, the crossovers the dispatcher moved show how
+// it reacts to whatever else is happening on the machine. -S seeds the
+// regimes (fib_dispatch_seed()) in place of FIB_DISPATCH_SEEDS; -S '' starts
+// them all unseeded.
+
+#define DEFAULT_CALLS 20000
+#define DEFAULT_MAX_INDEX 1000000
+#define DEFAULT_IMPLS "linear,fastexp,fastsquaring,gmp2"
+#define MAX_IMPLS FIB_DISPATCH_MAX_CANDIDATES
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// xorshift64*, reproducible across runs for a given seed
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static uint64_t log_uniform(uint64_t *state, uint64_t max_index)
+{
+    double const u = (next_random(state) >> 11) * 0x1p-53;
+    return (uint64_t)exp2(u * log2((double)max_index + 1));
+}
+
+static void usage(char const *argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [-i impl,...] [-n calls] [-m max_index] [-e report_every] [-s seed] [-S seeds]\n"
+        "Implementations:",
+        argv0);
+    fputc(' ', stderr);
+    fib_registry_list(stderr);
+    fputc('\n', stderr);
+}
+
+int main(int argc, char *argv[])
+{
+    char default_impls[] = DEFAULT_IMPLS;
+    char *selection = default_impls;
+    uint64_t calls = DEFAULT_CALLS;
+    uint64_t max_index = DEFAULT_MAX_INDEX;
+    uint64_t report_every = 0;
+    uint64_t seed = 1;
+    char const *seeds = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:m:e:s:S:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': selection = optarg; break;
+            case 'n': calls = strtoull(optarg, NULL, 0); break;
+            case 'm': max_index = strtoull(optarg, NULL, 0); break;
+            case 'e': report_every = strtoull(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'S': seeds = optarg; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    struct fib_impl const *impls[MAX_IMPLS];
+    unsigned const n = fib_registry_select(selection, impls, MAX_IMPLS);
+    if (n == 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    struct fib_dispatch *const dispatch = fib_dispatch_create(impls, n);
+    if (!dispatch)
+    {
+        perror("fib_dispatch_create");
+        return EXIT_FAILURE;
+    }
+    if (seeds && fib_dispatch_seed(dispatch, seeds) < 0)
+    {
+        fprintf(stderr, "Malformed seeds: %s\n", seeds);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t state = seed ? seed : 1;
+    double const start = now();
+    for (uint64_t call = 1; call <= calls; ++call)
+    {
+        struct number const result = fib_dispatch(dispatch, log_uniform(&state, max_index));
+        free(result.bytes);
+        if (report_every && call % report_every == 0 && call != calls)
+        {
+            printf("# after %llu calls, %.3f s\n", (long long unsigned)call, now() - start);
+            fib_dispatch_dump(dispatch, stdout);
+            putchar('\n');
+        }
+    }
+    printf("# after %llu calls, %.3f s\n", (long long unsigned)calls, now() - start);
+    fib_dispatch_dump(dispatch, stdout);
+
+    fib_dispatch_destroy(dispatch);
+    return EXIT_SUCCESS;
+}
@@ -1,8 +1,21 @@
+#define _GNU_SOURCE
 #include "fib_base.h"
+#include "fib_alloc.h"
+#include "fib_control.h"
+#include "fib_opcount.h"
+#include "fib_perf.h"
+#include "fib_results.h"
 
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <time.h>
-#include <pthread.h>
+#include <unistd.h>
 
 #define FIRST_CHECKPOINT 93 // F(93) is the largest 64-bit Fibonacci number
 #define SECOND_CHECKPOINT 0x2d7 // W Y S I
@@ -12,39 +25,220 @@
 #define HARD_CUTOFF_SEC 1
 #define HARD_CUTOFF_NSEC 0
 
-#define SLEEP_DURATION_NSEC 1000
 #define THREAD_TIMEOUT_SEC 5
 #define THREAD_TIMEOUT_NSEC 0
 
+// -B: the hard cutoff (the budget), the soft one half as much again
+#define SOFT_CUTOFF_RATIO 1.5
+
 // log of the number of samples to take
 #ifndef SAMPLE_LOG
 #   define SAMPLE_LOG 10
 #endif
 
+// harness mode (-w, -r, -c): every index is timed in a forked child pinned to
+// one CPU, HARNESS_WARMUP untimed runs then HARNESS_REPS timed ones
+#ifndef HARNESS_WARMUP
+#   define HARNESS_WARMUP 2
+#endif
+#ifndef HARNESS_REPS
+#   define HARNESS_REPS 7
+#endif
+#define MAX_REPS 1024
+
+// search mode (-s): the largest index within the budget, by bisection
+// rather than a sweep. Probes run in forked children, several at a time on
+// cores of their own (-j), SEARCH_WARMUP untimed runs then SEARCH_REPS
+// timed ones unless -w and -r say otherwise; a probe whose median lands
+// within SEARCH_NEAR of the budget is measured again with SEARCH_MAX_REPS
+// timed runs before it counts. Runs are cancelled past SEARCH_CANCEL times
+// the budget, which is then over. The search stops once the bracket is
+// narrower than 1/2^SEARCH_PRECISION of the index.
+#ifndef SEARCH_WARMUP
+#   define SEARCH_WARMUP 1
+#endif
+#ifndef SEARCH_REPS
+#   define SEARCH_REPS 3
+#endif
+#ifndef SEARCH_MAX_REPS
+#   define SEARCH_MAX_REPS 7
+#endif
+#ifndef SEARCH_NEAR
+#   define SEARCH_NEAR 0.1
+#endif
+#ifndef SEARCH_CANCEL
+#   define SEARCH_CANCEL 2.0
+#endif
+#ifndef SEARCH_PRECISION
+#   define SEARCH_PRECISION 10
+#endif
+#define MAX_PROBES 256
+
+// exit status of a harness child whose run was cancelled
+#define CHILD_CANCELLED 2
+
 struct timespec soft_cutoff = { SOFT_CUTOFF_SEC, SOFT_CUTOFF_NSEC };
 struct timespec hard_cutoff = { HARD_CUTOFF_SEC, HARD_CUTOFF_NSEC };
+time_t timeout_sec = THREAD_TIMEOUT_SEC;    // grows with the budget
+
+struct harness {
+    int enabled;
+    unsigned warmup;
+    unsigned reps;
+    int cpu;                        // -1: whichever the child starts on
+} harness = { 0, HARNESS_WARMUP, HARNESS_REPS, -1 };
+
+// -s, -j
+struct search {
+    int enabled;
+    unsigned probes;                // at a time, 0 for one per spare core
+    double cancel_after;            // seconds per run, 0 for never
+} search = { 0, 0, 0 };
+
+// -p: hardware counter columns
+int counters = 0;
+
+// -u: wall-clock, process CPU, peak memory and allocation columns
+int usage = 0;
+long online_cpus = 1;
+
+// -J: JSON lines (see fib_results.h) instead of the table, under the name
+// of the impl this binary was built with (bin/<impl>[.*].out)
+int json = 0;
+char impl_name[64] = "unknown";
+
+// The time column is the CPU time of the calling thread only, so it misses
+// any helper threads; these are for the whole process.
+struct usage {
+    double wall;                    // seconds
+    double cpu;                     // seconds, all threads
+    uint64_t peak_rss;              // KiB
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+};
+
+struct completion {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int finished;                   // completed or cancelled
+};
 
 struct fibonacci_args {
     long long unsigned index;
     struct number result;
-    struct timespec duration;
+    struct timespec duration;       // the median in harness mode
+    struct timespec minimum;
+    struct timespec p90;
+    double spread;                  // interquartile range over median, in %
+    double samples[MAX_REPS];       // every timed run in harness mode, sorted
+    unsigned nsamples;
+    struct usage usage;
+    uint64_t counters[FIB_PERF_COUNT];
+    uint64_t ops[FIB_OP_COUNT];     // OPCOUNT builds
     int thread_completed;
+    struct completion *completion;
+    struct fib_control *control;
+};
+
+// what a harness child sends back per timed run
+struct sample {
+    double seconds;
+    uint64_t length;
+    uint64_t low;                   // least significant 64 bits of the result
+    struct usage usage;
+    uint64_t counters[FIB_PERF_COUNT];
+    uint64_t ops[FIB_OP_COUNT];
 };
 
 int less(struct timespec const *const lhs, struct timespec const *const rhs);
+void print_header(void);
 void report(struct fibonacci_args const *const args);
 void *measure_fibonacci_call(void *fib_args);
 struct fibonacci_args evaluate_fibonacci(uint64_t index);
+struct fibonacci_args evaluate_isolated(uint64_t index);
+struct fibonacci_args evaluate(uint64_t index);
+uint64_t search_best(uint64_t low);
+
+static double seconds(struct timespec const *const t);
+static struct timespec to_timespec(double s);
 
-int main()
+int main(int argc, char *argv[])
 {
     uint64_t cur_idx = 0;
     uint64_t best_idx = 0;
 
-    puts(
-        "#   Fibonacci index  |   Time (s)   | Size (bytes) \n"
-        "# -------------------+--------------+--------------"
-    );
+    double budget = seconds(&hard_cutoff);
+    int warmup_set = 0, reps_set = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:r:c:puJsj:B:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'w': harness.warmup = strtoul(optarg, NULL, 0); warmup_set = 1; break;
+            case 'r': harness.reps = strtoul(optarg, NULL, 0); reps_set = 1; break;
+            case 'c': harness.cpu = atoi(optarg); break;
+            case 'p': counters = 1; continue;
+            case 'u': usage = 1; continue;
+            case 'J': json = 1; continue;
+            case 's': search.enabled = 1; break;
+            case 'j': search.probes = strtoul(optarg, NULL, 0); continue;
+            case 'B': budget = strtod(optarg, NULL); continue;
+            default:
+                fprintf(stderr, "Usage: %s [-w warmup] [-r reps] [-c cpu] [-p] [-u] [-J] [-s [-j probes]] [-B budget_s]\n",
+                    argv[0]);
+                return EXIT_FAILURE;
+        }
+        harness.enabled = 1;
+    }
+    if (!(budget > 0))
+    {
+        fprintf(stderr, "the budget must be positive\n");
+        return EXIT_FAILURE;
+    }
+    hard_cutoff = to_timespec(budget);
+    soft_cutoff = to_timespec(SOFT_CUTOFF_RATIO * budget);
+    if (3 * budget > THREAD_TIMEOUT_SEC)
+    {
+        timeout_sec = (time_t)(3 * budget) + 1;
+    }
+    if (search.enabled)
+    {
+        harness.warmup = warmup_set ? harness.warmup : SEARCH_WARMUP;
+        harness.reps = reps_set ? harness.reps : SEARCH_REPS;
+        search.cancel_after = SEARCH_CANCEL * budget;
+    }
+    if (harness.reps == 0 || harness.reps > MAX_REPS)
+    {
+        fprintf(stderr, "reps must be between 1 and %d\n", MAX_REPS);
+        return EXIT_FAILURE;
+    }
+
+    if (harness.enabled)
+    {
+        fprintf(stderr, "# %u warmup runs, %u timed runs per index\n", harness.warmup, harness.reps);
+    }
+    if (budget != HARD_CUTOFF_SEC + HARD_CUTOFF_NSEC * 1e-9)
+    {
+        fprintf(stderr, "# budget of %g s per call\n", budget);
+    }
+    if (counters)
+    {
+        struct fib_perf perf;
+        int const opened = fib_perf_open(&perf);
+        fib_perf_close(&perf);
+        if (opened < FIB_PERF_COUNT)
+        {
+            fprintf(stderr, "# %d of %d hardware counters available\n", opened, FIB_PERF_COUNT);
+        }
+    }
+    char const *base = strrchr(argv[0], '/');
+    base = base ? base + 1 : argv[0];
+    snprintf(impl_name, sizeof(impl_name), "%.*s", (int)strcspn(base, "."), base);
+
+    online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online_cpus < 1) { online_cpus = 1; }
+    print_header();
 
     // FIRST CHECKPOINT
     // (verify correctness against linear algorithm)
@@ -53,7 +247,7 @@ int main()
 
         for (; cur_idx <= FIRST_CHECKPOINT; ++cur_idx)
         {
-            struct fibonacci_args args = evaluate_fibonacci(cur_idx);
+            struct fibonacci_args args = evaluate(cur_idx);
             if (!args.thread_completed || !less(&args.duration, &soft_cutoff))
             {
                 free(args.result.bytes);
@@ -86,11 +280,17 @@ int main()
         }
     }
 
+    if (search.enabled)
+    {
+        best_idx = search_best(best_idx);
+        goto print_result;
+    }
+
     // SECOND CHECKPOINT
     {
         for (; cur_idx <= SECOND_CHECKPOINT; ++cur_idx)
         {
-            struct fibonacci_args args = evaluate_fibonacci(cur_idx);
+            struct fibonacci_args args = evaluate(cur_idx);
             free(args.result.bytes);
             if (!args.thread_completed || !less(&args.duration, &soft_cutoff))
             {
@@ -108,7 +308,7 @@ int main()
     // search for upper bound
     do
     {
-        struct fibonacci_args args = evaluate_fibonacci(cur_idx);
+        struct fibonacci_args args = evaluate(cur_idx);
         free(args.result.bytes);
         if (!args.thread_completed || !less(&args.duration, &hard_cutoff))
         {
@@ -134,7 +334,7 @@ int main()
         do
         {
             cur_idx += delta;
-            struct fibonacci_args args = evaluate_fibonacci(cur_idx);
+            struct fibonacci_args args = evaluate(cur_idx);
             free(args.result.bytes);
             if (cur_idx > best_idx && (!args.thread_completed || !less(&args.duration, &soft_cutoff)))
             {
@@ -153,6 +353,12 @@ print_result:
 
     fprintf(stderr, "# Recorded best: %llu\n",
             (long long unsigned)best_idx);
+    if (json)
+    {
+        printf("{\"type\":\"best\",\"impl\":");
+        fib_results_string(stdout, impl_name);
+        printf(",\"index\":%llu}\n", (long long unsigned)best_idx);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -163,36 +369,365 @@ int less(struct timespec const *const lhs, struct timespec const *const rhs)
         || (lhs->tv_sec == rhs->tv_sec && lhs->tv_nsec < rhs->tv_nsec);
 }
 
-void report(struct fibonacci_args const *const args)
+static void print_json_header(void)
 {
-    printf("%20llu | %llu.%09llus | %llu B\n",
-        (long long unsigned)args->index,
-        (long long unsigned)args->duration.tv_sec,
-        (long long unsigned)args->duration.tv_nsec,
-        (long long unsigned)args->result.length
+    fib_results_meta(stdout, "eval");
+    fputs(",\"impl\":", stdout);
+    fib_results_string(stdout, impl_name);
+    printf(",\"harness\":%s", harness.enabled ? "true" : "false");
+    if (harness.enabled)
+    {
+        printf(",\"warmup\":%u,\"reps\":%u,\"pinned_cpu\":%d", harness.warmup, harness.reps, harness.cpu);
+    }
+    printf(",\"budget_s\":%g,\"search\":%s", seconds(&hard_cutoff), search.enabled ? "true" : "false");
+    printf(",\"counters\":%s,\"usage\":%s,\"opcount\":%s}\n",
+        counters ? "true" : "false",
+        usage ? "true" : "false",
+        FIB_OPCOUNT_ENABLED ? "true" : "false");
+}
+
+void print_header(void)
+{
+    if (json)
+    {
+        print_json_header();
+        return;
+    }
+    fputs(harness.enabled
+        ? "#   Fibonacci index  |  Median (s)  |   Min (s)    |   p90 (s)    | IQR/med | Size (bytes) "
+        : "#   Fibonacci index  |   Time (s)   | Size (bytes) ",
+        stdout);
+    if (usage)
+    {
+        fputs("|   Wall (s)   |   CPU (s)    | Par. eff. | Peak RSS (KiB) |     Allocs     |  Alloc bytes   ", stdout);
+    }
+    for (int i = 0; counters && i < FIB_PERF_COUNT; ++i)
+    {
+        printf("| %14s ", fib_perf_names[i]);
+    }
+    for (int i = 0; FIB_OPCOUNT_ENABLED && i < FIB_OP_COUNT; ++i)
+    {
+        printf("| %14s ", fib_opcount_names[i]);
+    }
+    fputs(harness.enabled
+        ? "\n# -------------------+--------------+--------------+--------------+---------+--------------"
+        : "\n# -------------------+--------------+--------------",
+        stdout);
+    if (usage)
+    {
+        fputs("+--------------+--------------+-----------+----------------+----------------+----------------", stdout);
+    }
+    for (int i = 0; counters && i < FIB_PERF_COUNT; ++i)
+    {
+        fputs("+----------------", stdout);
+    }
+    for (int i = 0; FIB_OPCOUNT_ENABLED && i < FIB_OP_COUNT; ++i)
+    {
+        fputs("+----------------", stdout);
+    }
+    putchar('\n');
+}
+
+static void report_usage(struct usage const *u)
+{
+    if (!usage)
+    {
+        return;
+    }
+    double const efficiency = u->wall > 0 ? 100 * u->cpu / (u->wall * online_cpus) : 0;
+    printf(" | %11.9fs | %11.9fs | %8.2f%% | %14llu | %14llu | %14llu",
+        u->wall,
+        u->cpu,
+        efficiency,
+        (long long unsigned)u->peak_rss,
+        (long long unsigned)u->allocs,
+        (long long unsigned)u->alloc_bytes
     );
 }
 
+static void report_counters(uint64_t const *values)
+{
+    for (int i = 0; counters && i < FIB_PERF_COUNT; ++i)
+    {
+        if (values[i] == FIB_PERF_UNAVAILABLE)
+        {
+            printf(" | %14s", "-");
+        }
+        else
+        {
+            printf(" | %14llu", (long long unsigned)values[i]);
+        }
+    }
+}
+
+// an impl that counted nothing is not instrumented (the GMP ones)
+static void report_ops(uint64_t const *values)
+{
+    uint64_t any = 0;
+    for (int i = 0; i < FIB_OP_COUNT; ++i)
+    {
+        any |= values[i];
+    }
+    for (int i = 0; FIB_OPCOUNT_ENABLED && i < FIB_OP_COUNT; ++i)
+    {
+        if (any)
+        {
+            printf(" | %14llu", (long long unsigned)values[i]);
+        }
+        else
+        {
+            printf(" | %14s", "-");
+        }
+    }
+}
+
+// one result object; counters that are unavailable and the ops of impls
+// that count nothing are null
+static void report_json(struct fibonacci_args const *const args)
+{
+    fputs("{\"type\":\"result\",\"impl\":", stdout);
+    fib_results_string(stdout, impl_name);
+    printf(",\"index\":%llu,\"time_s\":%.9f", (long long unsigned)args->index, seconds(&args->duration));
+    if (harness.enabled)
+    {
+        printf(",\"min_s\":%.9f,\"p90_s\":%.9f,\"iqr_pct\":%.2f",
+            seconds(&args->minimum), seconds(&args->p90), args->spread);
+        for (unsigned i = 0; i < args->nsamples; ++i)
+        {
+            printf("%s%.9f", i ? "," : ",\"samples_s\":[", args->samples[i]);
+        }
+        fputs(args->nsamples ? "]" : "", stdout);
+    }
+    printf(",\"size_bytes\":%llu", (long long unsigned)args->result.length);
+    if (usage)
+    {
+        printf(",\"wall_s\":%.9f,\"cpu_s\":%.9f,\"peak_rss_kib\":%llu,\"allocs\":%llu,\"alloc_bytes\":%llu",
+            args->usage.wall,
+            args->usage.cpu,
+            (long long unsigned)args->usage.peak_rss,
+            (long long unsigned)args->usage.allocs,
+            (long long unsigned)args->usage.alloc_bytes);
+    }
+    if (counters)
+    {
+        fputs(",\"counters\":{", stdout);
+        for (int i = 0; i < FIB_PERF_COUNT; ++i)
+        {
+            fputs(i ? "," : "", stdout);
+            fib_results_string(stdout, fib_perf_names[i]);
+            if (args->counters[i] == FIB_PERF_UNAVAILABLE)
+            {
+                fputs(":null", stdout);
+            }
+            else
+            {
+                printf(":%llu", (long long unsigned)args->counters[i]);
+            }
+        }
+        putchar('}');
+    }
+    if (FIB_OPCOUNT_ENABLED)
+    {
+        uint64_t any = 0;
+        for (int i = 0; i < FIB_OP_COUNT; ++i)
+        {
+            any |= args->ops[i];
+        }
+        fputs(",\"ops\":", stdout);
+        for (int i = 0; any && i < FIB_OP_COUNT; ++i)
+        {
+            fputs(i ? "," : "{", stdout);
+            fib_results_string(stdout, fib_opcount_names[i]);
+            printf(":%llu", (long long unsigned)args->ops[i]);
+        }
+        fputs(any ? "}" : "null", stdout);
+    }
+    fputs("}\n", stdout);
+}
+
+void report(struct fibonacci_args const *const args)
+{
+    if (json)
+    {
+        report_json(args);
+        return;
+    }
+    if (harness.enabled)
+    {
+        printf("%20llu | %llu.%09llus | %llu.%09llus | %llu.%09llus | %6.2f%% | %llu B",
+            (long long unsigned)args->index,
+            (long long unsigned)args->duration.tv_sec,
+            (long long unsigned)args->duration.tv_nsec,
+            (long long unsigned)args->minimum.tv_sec,
+            (long long unsigned)args->minimum.tv_nsec,
+            (long long unsigned)args->p90.tv_sec,
+            (long long unsigned)args->p90.tv_nsec,
+            args->spread,
+            (long long unsigned)args->result.length
+        );
+    }
+    else
+    {
+        printf("%20llu | %llu.%09llus | %llu B",
+            (long long unsigned)args->index,
+            (long long unsigned)args->duration.tv_sec,
+            (long long unsigned)args->duration.tv_nsec,
+            (long long unsigned)args->result.length
+        );
+    }
+    report_usage(&args->usage);
+    report_counters(args->counters);
+    report_ops(args->ops);
+    putchar('\n');
+}
+
+static double seconds(struct timespec const *const t)
+{
+    return t->tv_sec + t->tv_nsec * 1e-9;
+}
+
+static struct timespec to_timespec(double s)
+{
+    struct timespec t;
+    t.tv_sec = (time_t)s;
+    t.tv_nsec = (long)((s - t.tv_sec) * 1e9);
+    return t;
+}
+
+// Resets the peak RSS of the process to its current RSS (Linux 4.0+); if
+// that fails, peak_rss() reports the peak since the process started.
+static void reset_peak_rss(void)
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f)
+    {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+// peak RSS in KiB
+static uint64_t peak_rss(void)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f)
+    {
+        char line[256];
+        long long unsigned kib;
+        while (fgets(line, sizeof(line), f))
+        {
+            if (sscanf(line, "VmHWM: %llu kB", &kib) == 1)
+            {
+                fclose(f);
+                return kib;
+            }
+        }
+        fclose(f);
+    }
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
 void *measure_fibonacci_call(void *fib_args)
 {
     struct fibonacci_args *args = fib_args;
 
+    // opened on the measuring thread, since they count the calling thread
+    struct fib_perf perf;
+    if (counters)
+    {
+        fib_perf_open(&perf);
+        fib_perf_start(&perf);
+    }
+
+    struct fib_alloc_stats alloc_start;
+    struct timespec wall_start, cpu_start;
+    if (usage)
+    {
+        reset_peak_rss();
+        alloc_start = fib_alloc_stats();
+        clock_gettime(CLOCK_MONOTONIC, &wall_start);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    }
+
+    if (FIB_OPCOUNT_ENABLED)
+    {
+        fib_opcount_reset();
+    }
+
     struct timespec start_time;
     clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
 
+    fib_control_attach(args->control);
     args->result = fibonacci(args->index);
+    fib_control_attach(NULL);
 
     struct timespec end_time;
     clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
 
+    if (usage)
+    {
+        struct timespec wall_end, cpu_end;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+        clock_gettime(CLOCK_MONOTONIC, &wall_end);
+        struct fib_alloc_stats const alloc_end = fib_alloc_stats();
+
+        args->usage.wall = seconds(&wall_end) - seconds(&wall_start);
+        args->usage.cpu = seconds(&cpu_end) - seconds(&cpu_start);
+        args->usage.peak_rss = peak_rss();
+        args->usage.allocs = alloc_end.count - alloc_start.count;
+        args->usage.alloc_bytes = alloc_end.bytes - alloc_start.bytes;
+    }
+
+    if (counters)
+    {
+        fib_perf_stop(&perf, args->counters);
+        fib_perf_close(&perf);
+    }
+    if (FIB_OPCOUNT_ENABLED)
+    {
+        fib_opcount_read(args->ops);
+    }
+
     args->duration.tv_sec = end_time.tv_sec - start_time.tv_sec;
     args->duration.tv_nsec = end_time.tv_nsec - start_time.tv_nsec;
-    args->thread_completed = 1;
+    if (args->duration.tv_nsec < 0)
+    {
+        args->duration.tv_sec -= 1;
+        args->duration.tv_nsec += 1000000000;
+    }
+    args->thread_completed = args->result.bytes != NULL;
+
+    if (args->completion)
+    {
+        pthread_mutex_lock(&args->completion->lock);
+        args->completion->finished = 1;
+        pthread_cond_signal(&args->completion->cond);
+        pthread_mutex_unlock(&args->completion->lock);
+    }
     return NULL;
 }
 
 struct fibonacci_args evaluate_fibonacci(uint64_t index)
 {
+    // the impls give up by themselves at the deadline; the cancel flag below
+    // is for the ones that only check it between long GMP calls
+    struct fib_control control = { .cancel = 0 };
+    clock_gettime(CLOCK_MONOTONIC, &control.deadline);
+    control.deadline.tv_sec += timeout_sec;
+    control.deadline.tv_nsec += THREAD_TIMEOUT_NSEC;
+
+    // the waiting thread sleeps on a condition variable instead of polling
+    // the clock, so it takes no CPU from the measured one
+    struct completion completion = { .finished = 0 };
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&completion.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&completion.lock, NULL);
+
     struct fibonacci_args args = {
         .index = index,
         .result = {
@@ -204,42 +739,519 @@ struct fibonacci_args evaluate_fibonacci(uint64_t index)
             .tv_nsec = 0,
         },
         .thread_completed = 0,
+        .completion = &completion,
+        .control = &control,
     };
 
     pthread_t thread;
     pthread_create(&thread, NULL, measure_fibonacci_call, &args);
 
-    struct timespec cutoff_time;
-    clock_gettime(CLOCK_MONOTONIC, &cutoff_time);
-    cutoff_time.tv_sec += THREAD_TIMEOUT_SEC;
-    cutoff_time.tv_nsec += THREAD_TIMEOUT_NSEC;
+    pthread_mutex_lock(&completion.lock);
+    int status = 0;
+    while (!completion.finished && status != ETIMEDOUT)
+    {
+        status = pthread_cond_timedwait(&completion.cond, &completion.lock, &control.deadline);
+    }
+
+    // timeout: ask the computation to stop, and wait for it to clean up
+    if (!completion.finished)
+    {
+        atomic_store(&control.cancel, 1);
+    }
+    pthread_mutex_unlock(&completion.lock);
+    pthread_join(thread, NULL);
 
-    struct timespec cur_time;
+    pthread_cond_destroy(&completion.cond);
+    pthread_mutex_destroy(&completion.lock);
 
-    static const struct timespec sleep_duration = { 0, SLEEP_DURATION_NSEC };
-    do
+    if (!args.thread_completed)
+    {
+        fprintf(stderr, "# F(%llu) cancelled after %llu of %llu steps\n",
+            args.index,
+            (long long unsigned)atomic_load(&control.done),
+            (long long unsigned)atomic_load(&control.total)
+        );
+    }
+    args.completion = NULL;
+    args.control = NULL;
+    return args;
+}
+
+static int write_sample(int fd, struct sample const *sample)
+{
+    uint8_t const *bytes = (uint8_t const *)sample;
+    size_t left = sizeof(*sample);
+    while (left)
     {
-        nanosleep(&sleep_duration, NULL);
-        clock_gettime(CLOCK_MONOTONIC, &cur_time);
-        if (args.thread_completed)
+        ssize_t written = write(fd, bytes, left);
+        if (written < 0)
         {
-            pthread_join(thread, NULL);
-            return args;
+            if (errno == EINTR) { continue; }
+            return -1;
         }
+        bytes += written;
+        left -= written;
     }
-    while (less(&cur_time, &cutoff_time));
-    // 1 second grace
+    return 0;
+}
 
-    // timeout
-    pthread_cancel(thread);
-    pthread_join(thread, NULL);
+// Body of a harness child: pins itself to cpu (or wherever it started, for
+// -1), runs the warmup, then streams one struct sample per timed run to fd.
+// Never returns.
+static void run_child(uint64_t index, int cpu, unsigned runs, int fd)
+{
+    if (cpu < 0)
+    {
+        cpu = sched_getcpu();
+    }
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set))
+        {
+            perror("sched_setaffinity");
+        }
+    }
 
-    // invalidate arg values, and maybe cleanup
-    if (args.result.bytes)
+    for (unsigned run = 0; run < harness.warmup + runs; ++run)
     {
+        struct fib_control control = { .cancel = 0 };
+        if (search.cancel_after > 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &control.deadline);
+            struct timespec const allowance = to_timespec(search.cancel_after);
+            control.deadline.tv_sec += allowance.tv_sec;
+            control.deadline.tv_nsec += allowance.tv_nsec;
+            if (control.deadline.tv_nsec >= 1000000000)
+            {
+                control.deadline.tv_sec += 1;
+                control.deadline.tv_nsec -= 1000000000;
+            }
+        }
+        struct fibonacci_args args = {
+            .index = index,
+            .completion = NULL,
+            .control = search.cancel_after > 0 ? &control : NULL,
+        };
+        measure_fibonacci_call(&args);
+        if (!args.thread_completed)
+        {
+            _exit(search.cancel_after > 0 ? CHILD_CANCELLED : EXIT_FAILURE);
+        }
+
+        struct sample sample = {
+            .seconds = seconds(&args.duration),
+            .length = args.result.length,
+            .low = 0,
+        };
+        sample.usage = args.usage;
+        memcpy(sample.counters, args.counters, sizeof(sample.counters));
+        memcpy(sample.ops, args.ops, sizeof(sample.ops));
+        memcpy(&sample.low, args.result.bytes,
+            args.result.length < sizeof(sample.low) ? args.result.length : sizeof(sample.low));
         free(args.result.bytes);
-        args.result.bytes = NULL;
+
+        if (run >= harness.warmup && write_sample(fd, &sample))
+        {
+            _exit(EXIT_FAILURE);
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static int compare_double(void const *lhs, void const *rhs)
+{
+    double const a = *(double const *)lhs, b = *(double const *)rhs;
+    return (a > b) - (a < b);
+}
+
+// nearest-rank quantile of sorted[0, n)
+static double quantile(double const *sorted, unsigned n, double q)
+{
+    unsigned rank = (unsigned)(q * n + 0.999999);
+    if (rank < 1) { rank = 1; }
+    if (rank > n) { rank = n; }
+    return sorted[rank - 1];
+}
+
+static int compare_u64(void const *lhs, void const *rhs)
+{
+    uint64_t const a = *(uint64_t const *)lhs, b = *(uint64_t const *)rhs;
+    return (a > b) - (a < b);
+}
+
+// median of the counts (sorted in place), unavailable if any run lacked it
+static uint64_t median_count(uint64_t *counts, unsigned n)
+{
+    qsort(counts, n, sizeof(counts[0]), compare_u64);
+    return counts[n - 1] == FIB_PERF_UNAVAILABLE ? FIB_PERF_UNAVAILABLE : counts[n / 2];
+}
+
+// field by field medians
+static struct usage median_usage(struct usage const *usages, unsigned n)
+{
+    static double values[MAX_REPS];
+    static uint64_t counts[MAX_REPS];
+    struct usage median;
+
+#   define MEDIAN_OF(field, array, compare) \
+    for (unsigned i = 0; i < n; ++i) { array[i] = usages[i].field; } \
+    qsort(array, n, sizeof(array[0]), compare); \
+    median.field = array[n / 2];
+
+    MEDIAN_OF(wall, values, compare_double)
+    MEDIAN_OF(cpu, values, compare_double)
+    MEDIAN_OF(peak_rss, counts, compare_u64)
+    MEDIAN_OF(allocs, counts, compare_u64)
+    MEDIAN_OF(alloc_bytes, counts, compare_u64)
+#   undef MEDIAN_OF
+
+    return median;
+}
+
+// a harness child at work, read back by probe_finish()
+struct probe {
+    uint64_t index;
+    unsigned runs;                  // timed ones
+    pid_t pid;
+    int fd;
+    struct timespec started;
+};
+
+// Forks a harness child timing runs calls of F(index) on cpu.
+static int probe_start(struct probe *probe, uint64_t index, int cpu, unsigned runs)
+{
+    probe->index = index;
+    probe->runs = runs;
+
+    int fds[2];
+    if (pipe(fds))
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);
+    pid_t const pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        run_child(index, cpu, runs, fds[1]);
+    }
+    close(fds[1]);
+    probe->pid = pid;
+    probe->fd = fds[0];
+    clock_gettime(CLOCK_MONOTONIC, &probe->started);
+    return 0;
+}
+
+// Reads the samples of probe back and reaps the child; the result is the
+// median run, or not completed.
+static struct fibonacci_args probe_finish(struct probe *probe)
+{
+    struct fibonacci_args args = {
+        .index = probe->index,
+        .thread_completed = 0,
+    };
+    pid_t const pid = probe->pid;
+    int const fd = probe->fd;
+
+    // every sample must arrive within the timeout of the one before it (the
+    // first one gets a timeout per warmup run too), or the child is killed
+    static double times[MAX_REPS];
+    static uint64_t counts[FIB_PERF_COUNT][MAX_REPS];
+    static struct usage usages[MAX_REPS];
+    struct sample sample;
+    unsigned count = 0;
+    size_t have = 0;
+    int timed_out = 0;
+
+    struct timespec deadline = probe->started;
+    deadline.tv_sec += (time_t)(harness.warmup + 1) * timeout_sec;
+
+    while (count < probe->runs)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long const left_ms = (deadline.tv_sec - now.tv_sec) * 1000
+            + (deadline.tv_nsec - now.tv_nsec) / 1000000;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int const ready = left_ms > 0 ? poll(&pfd, 1, (int)left_ms) : 0;
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            timed_out = ready == 0;
+            break;
+        }
+
+        ssize_t const got = read(fd, (uint8_t *)&sample + have, sizeof(sample) - have);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        have += got;
+        if (have < sizeof(sample))
+        {
+            continue;
+        }
+        have = 0;
+
+        for (int i = 0; i < FIB_PERF_COUNT; ++i)
+        {
+            counts[i][count] = sample.counters[i];
+        }
+        usages[count] = sample.usage;
+        times[count++] = sample.seconds;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_sec;
+    }
+    close(fd);
+
+    if (timed_out)
+    {
+        kill(pid, SIGKILL);
     }
-    args.thread_completed = 0;
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    if (count < probe->runs)
+    {
+        int const cancelled = !timed_out && WIFEXITED(status) && WEXITSTATUS(status) == CHILD_CANCELLED;
+        fprintf(stderr, "# F(%llu) %s after %u of %u timed runs\n",
+            args.index, timed_out ? "timed out" : cancelled ? "cancelled" : "failed", count, probe->runs);
+        return args;
+    }
+
+    qsort(times, count, sizeof(times[0]), compare_double);
+    double const median = count % 2
+        ? times[count / 2]
+        : (times[count / 2 - 1] + times[count / 2]) / 2;
+
+    args.duration = to_timespec(median);
+    args.minimum = to_timespec(times[0]);
+    memcpy(args.samples, times, count * sizeof(times[0]));
+    args.nsamples = count;
+    args.p90 = to_timespec(quantile(times, count, 0.9));
+    args.spread = median > 0
+        ? 100 * (quantile(times, count, 0.75) - quantile(times, count, 0.25)) / median
+        : 0;
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        args.counters[i] = median_count(counts[i], count);
+    }
+    if (usage)
+    {
+        args.usage = median_usage(usages, count);
+    }
+
+    // the same on every run
+    memcpy(args.ops, sample.ops, sizeof(args.ops));
+
+    // main() only looks at the low word and the length of the result
+    args.result.bytes = malloc(sizeof(sample.low));
+    memcpy(args.result.bytes, &sample.low, sizeof(sample.low));
+    args.result.length = sample.length;
+    args.thread_completed = 1;
     return args;
 }
+
+struct fibonacci_args evaluate_isolated(uint64_t index)
+{
+    struct probe probe;
+    if (probe_start(&probe, index, harness.cpu, harness.reps))
+    {
+        return (struct fibonacci_args){ .index = index, .thread_completed = 0 };
+    }
+    return probe_finish(&probe);
+}
+
+struct fibonacci_args evaluate(uint64_t index)
+{
+    return harness.enabled ? evaluate_isolated(index) : evaluate_fibonacci(index);
+}
+
+// Cores for the probes: -c's alone, or every allowed one but the first
+// (left to the interrupts and the rest of the system) if there are more
+// than two.
+static unsigned probe_cpus(int *cpus)
+{
+    if (harness.cpu >= 0)
+    {
+        cpus[0] = harness.cpu;
+        return 1;
+    }
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    unsigned n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpus[n++] = cpu;
+        }
+    }
+    if (n > 2)
+    {
+        memmove(cpus, cpus + 1, --n * sizeof(cpus[0]));
+    }
+    if (n == 0)
+    {
+        cpus[n++] = -1;
+    }
+    return n;
+}
+
+// Probes indices[0, n) at once, on a core each (round robin if there are
+// fewer); within[i] is whether F(indices[i]) took less than the budget, after
+// a second, longer look at the ones too close to it to tell.
+static void probe_round(uint64_t const *indices, unsigned n, int const *cpus, unsigned ncpus, int *within)
+{
+    static struct probe probes[MAX_PROBES];
+    static struct fibonacci_args args[MAX_PROBES];
+    int started[MAX_PROBES];
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        started[i] = !probe_start(&probes[i], indices[i], cpus[i % ncpus], harness.reps);
+    }
+    for (unsigned i = 0; i < n; ++i)
+    {
+        args[i] = started[i]
+            ? probe_finish(&probes[i])
+            : (struct fibonacci_args){ .index = indices[i], .thread_completed = 0 };
+    }
+
+    double const budget = seconds(&hard_cutoff);
+    for (unsigned i = 0; harness.reps < SEARCH_MAX_REPS && i < n; ++i)
+    {
+        double const ratio = seconds(&args[i].duration) / budget;
+        started[i] = args[i].thread_completed && ratio > 1 - SEARCH_NEAR && ratio < 1 + SEARCH_NEAR
+            && !probe_start(&probes[i], indices[i], cpus[i % ncpus], SEARCH_MAX_REPS);
+        if (started[i])
+        {
+            free(args[i].result.bytes);
+        }
+    }
+    for (unsigned i = 0; harness.reps < SEARCH_MAX_REPS && i < n; ++i)
+    {
+        if (started[i])
+        {
+            args[i] = probe_finish(&probes[i]);
+        }
+    }
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        if (args[i].thread_completed)
+        {
+            report(&args[i]);
+        }
+        within[i] = args[i].thread_completed && less(&args[i].duration, &hard_cutoff);
+        free(args[i].result.bytes);
+    }
+}
+
+// -s: the largest index above low (which is within the budget) that is
+// still within it, with runtime growing with the index. The bracket is found
+// by doubling the index from one probe to the next, then split into as many
+// parts as there are probes at a time, and the first probe over the budget
+// closes it; past it, a probe within the budget can only be noise.
+uint64_t search_best(uint64_t low)
+{
+    static int cpus[CPU_SETSIZE];
+    unsigned const ncpus = probe_cpus(cpus);
+    unsigned width = search.probes ? search.probes : ncpus;
+    if (width > MAX_PROBES)
+    {
+        width = MAX_PROBES;
+    }
+    fprintf(stderr, "# search: %u probes at a time on %u core%s\n", width, ncpus, ncpus == 1 ? "" : "s");
+    if (width > ncpus)
+    {
+        fprintf(stderr, "# more probes than cores: they disturb each other's times\n");
+    }
+    // the deadline is wall-clock, and probes sharing a core get a share of it
+    search.cancel_after *= (width + ncpus - 1) / ncpus;
+
+    uint64_t indices[MAX_PROBES];
+    int within[MAX_PROBES];
+    uint64_t high = 0;                      // the first index over, 0 until there is one
+    unsigned rounds = 0;
+
+    while (!high)
+    {
+        uint64_t const base = low ? low : 1;
+        unsigned n = 0;
+        for (; n < width && base <= UINT64_MAX >> (n + 1); ++n)
+        {
+            indices[n] = base << (n + 1);
+        }
+        if (n == 0)
+        {
+            return low;
+        }
+        probe_round(indices, n, cpus, ncpus, within);
+        ++rounds;
+        for (unsigned i = 0; i < n && !high; ++i)
+        {
+            if (within[i])
+            {
+                low = indices[i];
+            }
+            else
+            {
+                high = indices[i];
+            }
+        }
+    }
+
+    while (high - low > 1 && high - low > low >> SEARCH_PRECISION)
+    {
+        uint64_t const gap = high - low;
+        unsigned const n = gap - 1 < width ? (unsigned)(gap - 1) : width;
+        for (unsigned i = 0; i < n; ++i)
+        {
+            // low + gap * (i + 1) / (n + 1), without overflowing
+            indices[i] = low + gap / (n + 1) * (i + 1) + gap % (n + 1) * (i + 1) / (n + 1);
+        }
+        probe_round(indices, n, cpus, ncpus, within);
+        ++rounds;
+        uint64_t next_high = high;
+        for (unsigned i = 0; i < n && next_high == high; ++i)
+        {
+            if (within[i])
+            {
+                low = indices[i];
+            }
+            else
+            {
+                next_high = indices[i];
+            }
+        }
+        high = next_high;
+    }
+
+    fprintf(stderr, "# search: %u rounds, F(%llu) within the budget, F(%llu) over\n",
+        rounds, (long long unsigned)low, (long long unsigned)high);
+    return low;
+}
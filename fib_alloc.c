@@ -0,0 +1,77 @@
+#include "fib_alloc.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+
+// glibc's allocator, under the names it exports for exactly this purpose
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static atomic_uint_least64_t alloc_count;
+static atomic_uint_least64_t alloc_bytes;
+
+static inline void *counted(void *ptr, size_t size)
+{
+    if (ptr)
+    {
+        atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    }
+    return ptr;
+}
+
+void *malloc(size_t size)
+{
+    return counted(__libc_malloc(size), size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    return counted(__libc_calloc(count, size), count * size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    return counted(__libc_realloc(ptr, size), size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return counted(__libc_memalign(alignment, size), size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return counted(__libc_memalign(alignment, size), size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) || (alignment & (alignment - 1)))
+    {
+        return EINVAL;
+    }
+    void *p = counted(__libc_memalign(alignment, size), size);
+    if (!p && size)
+    {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+struct fib_alloc_stats fib_alloc_stats(void)
+{
+    return (struct fib_alloc_stats){
+        atomic_load_explicit(&alloc_count, memory_order_relaxed),
+        atomic_load_explicit(&alloc_bytes, memory_order_relaxed),
+    };
+}
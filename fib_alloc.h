@@ -0,0 +1,22 @@
+#ifndef FIB_ALLOC_H
+#define FIB_ALLOC_H
+
+#include "fib_base.h"
+
+// Allocation counting for the measurement drivers.
+//
+// fib_alloc.c interposes malloc, calloc, realloc and the aligned allocators
+// on glibc's own (__libc_malloc and friends), counting every allocation and
+// the bytes requested, from any thread, GMP's included. It is linked into
+// eval only (not archived into libfib.a, where it would resolve malloc for
+// every program); other drivers keep the plain allocator.
+
+struct fib_alloc_stats {
+    uint64_t count;     // allocations, reallocations included
+    uint64_t bytes;     // bytes requested by them
+};
+
+// Totals since the program started.
+struct fib_alloc_stats fib_alloc_stats(void);
+
+#endif//FIB_ALLOC_H
@@ -0,0 +1,59 @@
+#include "fib_batch.h"
+
+static int compare_items(void const *lhs, void const *rhs)
+{
+    struct fib_batch_item const *a = lhs;
+    struct fib_batch_item const *b = rhs;
+    if (a->key != b->key)
+    {
+        return a->key < b->key ? -1 : 1;
+    }
+    return (a->depth > b->depth) - (a->depth < b->depth);
+}
+
+struct fib_batch_item *fib_batch_sort(uint64_t const *indices, size_t count)
+{
+    struct fib_batch_item *items = malloc((count ? count : 1) * sizeof(*items));
+    if (!items)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t const index = indices[i];
+        unsigned const shift = index ? __builtin_clzll(index) : 0;
+        items[i].key = index << shift;
+        items[i].depth = index ? 64 - shift : 0;
+        items[i].slot = i;
+    }
+    qsort(items, count, sizeof(*items), compare_items);
+    return items;
+}
+
+size_t fib_batch_skip(struct fib_batch_item const *items, size_t lo, size_t hi, unsigned depth)
+{
+    while (lo < hi && items[lo].depth == depth)
+    {
+        ++lo;
+    }
+    return lo;
+}
+
+size_t fib_batch_split(struct fib_batch_item const *items, size_t lo, size_t hi, unsigned depth)
+{
+    uint64_t const bit = 1ull << (63 - depth);
+    while (lo < hi)
+    {
+        size_t const mid = lo + (hi - lo) / 2;
+        if (items[mid].key & bit)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
@@ -0,0 +1,31 @@
+#ifndef FIB_BATCH_H
+#define FIB_BATCH_H
+
+#include "fib_base.h"
+
+// Helpers for fibonacci_many().
+//
+// The doubling loops consume an index from its top bit down, so the state
+// after d steps only depends on the top d bits. Left-aligning every index
+// (shifting its top bit to bit 63) and sorting turns the set of indices into
+// a binary trie laid out in an array: all indices sharing a d-bit prefix are
+// contiguous, those ending at depth d come first, and the rest are split in
+// two by bit 63 - d.
+
+struct fib_batch_item {
+    uint64_t key;       // index << clz(index), 0 for index 0
+    unsigned depth;     // number of significant bits in the index
+    size_t slot;        // position in the caller's arrays
+};
+
+// Returns the items sorted in trie order, or NULL if allocation fails.
+struct fib_batch_item *fib_batch_sort(uint64_t const *indices, size_t count);
+
+// First item in [lo, hi) that continues past depth.
+size_t fib_batch_skip(struct fib_batch_item const *items, size_t lo, size_t hi, unsigned depth);
+
+// First item in [lo, hi) whose bit after the shared depth-bit prefix is set.
+// Every item in [lo, hi) must continue past depth.
+size_t fib_batch_split(struct fib_batch_item const *items, size_t lo, size_t hi, unsigned depth);
+
+#endif//FIB_BATCH_H
@@ -0,0 +1,171 @@
+#include "fib_checkpoint.h"
+#include "fib_checksum.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define ROUND_UP(x, align) (((x) + (align) - 1) / (align) * (align))
+
+static double seconds_since(struct timespec const *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static int write_all(int fd, void const *buf, size_t len, uint64_t offset)
+{
+    uint8_t const *bytes = buf;
+    while (len)
+    {
+        ssize_t written = pwrite(fd, bytes, len, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        bytes += written;
+        offset += written;
+        len -= written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len, uint64_t offset)
+{
+    uint8_t *bytes = buf;
+    while (len)
+    {
+        ssize_t got = pread(fd, bytes, len, offset);
+        if (got <= 0)
+        {
+            if (got < 0 && errno == EINTR) { continue; }
+            return -1;
+        }
+        bytes += got;
+        offset += got;
+        len -= got;
+    }
+    return 0;
+}
+
+int fib_checkpoint_begin(struct fib_checkpointer *cp)
+{
+    char const *path = getenv(FIB_CHECKPOINT_ENV);
+    cp->path = path && *path ? path : NULL;
+
+    char const *interval = getenv(FIB_CHECKPOINT_INTERVAL_ENV);
+    cp->interval = interval && *interval ? strtod(interval, NULL) : FIB_CHECKPOINT_DEFAULT_INTERVAL;
+    clock_gettime(CLOCK_MONOTONIC, &cp->last);
+    return cp->path != NULL;
+}
+
+int fib_checkpoint_due(struct fib_checkpointer *cp)
+{
+    return cp->path && seconds_since(&cp->last) >= cp->interval;
+}
+
+int fib_checkpoint_save(struct fib_checkpointer *cp, enum fib_checkpoint_algorithm algorithm,
+        uint64_t index, uint64_t mask, struct number const state[2])
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cp->path);
+
+    struct fib_checkpoint_header header = {
+        .magic = FIB_CHECKPOINT_MAGIC,
+        .version = FIB_CHECKPOINT_VERSION,
+        .algorithm = algorithm,
+        .byte_order = FIB_CHECKPOINT_BYTE_ORDER,
+        .index = index,
+        .mask = mask,
+    };
+    for (int i = 0; i < 2; ++i)
+    {
+        header.length[i] = state[i].length;
+        header.checksum[i] = fib_checksum(state[i].bytes, state[i].length);
+    }
+    header.header_checksum = fib_checksum(&header, offsetof(struct fib_checkpoint_header, header_checksum));
+
+    // the values go straight from the impl's buffers, without a copy
+    uint64_t const second = sizeof(header) + ROUND_UP(state[0].length, sizeof(uint64_t));
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (write_all(fd, state[0].bytes, state[0].length, sizeof(header))
+            || write_all(fd, state[1].bytes, state[1].length, second)
+            || ftruncate(fd, second + state[1].length)
+            || write_all(fd, &header, sizeof(header), 0)
+            || fsync(fd))
+    {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    if (close(fd) || rename(tmp_path, cp->path))
+    {
+        unlink(tmp_path);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &cp->last);
+    return 0;
+}
+
+int fib_checkpoint_resume(enum fib_checkpoint_algorithm algorithm,
+        uint64_t index, uint64_t *mask, struct number state[2])
+{
+    char const *path = getenv(FIB_CHECKPOINT_ENV);
+    char const *resume = getenv(FIB_RESUME_ENV);
+    if (!path || !*path || !resume || !*resume || !strcmp(resume, "0"))
+    {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct fib_checkpoint_header header;
+    if (read_all(fd, &header, sizeof(header), 0)
+            || memcmp(header.magic, FIB_CHECKPOINT_MAGIC, sizeof(header.magic))
+            || header.version != FIB_CHECKPOINT_VERSION
+            || header.byte_order != FIB_CHECKPOINT_BYTE_ORDER
+            || header.header_checksum != fib_checksum(&header, offsetof(struct fib_checkpoint_header, header_checksum))
+            || header.algorithm != (uint32_t)algorithm
+            || header.index != index
+            || (header.mask & (header.mask - 1))
+            || (index && header.mask >> (63 - __builtin_clzll(index))))
+    {
+        close(fd);
+        return -1;
+    }
+
+    uint64_t offset = sizeof(header);
+    for (int i = 0; i < 2; ++i)
+    {
+        // one spare limb of zeros, as the impls expect from their own buffers
+        state[i].length = header.length[i];
+        state[i].bytes = calloc(ROUND_UP(header.length[i], sizeof(uint64_t)) + sizeof(uint64_t), 1);
+        if (!state[i].bytes
+                || read_all(fd, state[i].bytes, state[i].length, offset)
+                || fib_checksum(state[i].bytes, state[i].length) != header.checksum[i])
+        {
+            free(state[0].bytes);
+            if (i) { free(state[1].bytes); }
+            close(fd);
+            return -1;
+        }
+        offset += ROUND_UP(header.length[i], sizeof(uint64_t));
+    }
+
+    close(fd);
+    *mask = header.mask;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef FIB_CHECKPOINT_H
+#define FIB_CHECKPOINT_H
+
+#include "fib_base.h"
+
+#include <time.h>
+
+// Checkpoint and resume for long doubling loops.
+//
+// With $FIB_CHECKPOINT set, the doubling impls save their state to that
+// file at most every $FIB_CHECKPOINT_INTERVAL seconds (default
+// FIB_CHECKPOINT_DEFAULT_INTERVAL): the two values of the current pair,
+// the mask of the next index bit to consume, and which impl wrote it, since
+// gmp2 keeps (F(m), F(m+1)) and fastsquaring (F(m-1), F(m)). The file is
+// written next to the old one and renamed over it, so a crash while saving
+// leaves the previous checkpoint intact.
+//
+// With $FIB_RESUME set as well, fibonacci() starts from that checkpoint if
+// it was written by the same impl for the same index and its checksums
+// hold, and from scratch (or the store) otherwise.
+//
+// Layout:
+//   struct fib_checkpoint_header
+//   value[0], zero-padded to a multiple of 8 bytes
+//   value[1]
+
+#define FIB_CHECKPOINT_MAGIC "FIBCKPT"
+#define FIB_CHECKPOINT_VERSION 1
+#define FIB_CHECKPOINT_BYTE_ORDER 0x0102030405060708ull
+
+#define FIB_CHECKPOINT_ENV "FIB_CHECKPOINT"
+#define FIB_CHECKPOINT_INTERVAL_ENV "FIB_CHECKPOINT_INTERVAL"
+#define FIB_RESUME_ENV "FIB_RESUME"
+
+// seconds between checkpoints
+#ifndef FIB_CHECKPOINT_DEFAULT_INTERVAL
+#   define FIB_CHECKPOINT_DEFAULT_INTERVAL 600
+#endif
+
+enum fib_checkpoint_algorithm {
+    FIB_CHECKPOINT_GMP2 = 1,
+    FIB_CHECKPOINT_FASTSQUARING = 2,
+};
+
+struct fib_checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t algorithm;
+    uint64_t byte_order;
+    uint64_t index;
+    uint64_t mask;              // next bit of index to consume, 0 when done
+    uint64_t length[2];         // bytes, little-endian
+    uint64_t checksum[2];
+    uint64_t header_checksum;   // of everything above
+};
+
+struct fib_checkpointer {
+    char const *path;           // NULL if checkpointing is off
+    double interval;
+    struct timespec last;
+};
+
+// Reads the environment and starts the interval clock.
+// Returns nonzero if checkpointing is on.
+int fib_checkpoint_begin(struct fib_checkpointer *cp);
+
+// Nonzero if checkpointing is on and the interval has elapsed.
+int fib_checkpoint_due(struct fib_checkpointer *cp);
+
+// Saves the state and restarts the interval clock. Returns 0 on success;
+// on failure the previous checkpoint, if any, is left as it was.
+int fib_checkpoint_save(struct fib_checkpointer *cp, enum fib_checkpoint_algorithm algorithm,
+        uint64_t index, uint64_t mask, struct number const state[2]);
+
+// If resuming is asked for and the checkpoint matches algorithm and index,
+// fills *mask and state (malloc'ed, to be freed by the caller) and returns 0.
+// Returns -1 otherwise.
+int fib_checkpoint_resume(enum fib_checkpoint_algorithm algorithm,
+        uint64_t index, uint64_t *mask, struct number state[2]);
+
+#endif//FIB_CHECKPOINT_H
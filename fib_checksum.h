@@ -0,0 +1,33 @@
+#ifndef FIB_CHECKSUM_H
+#define FIB_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FIB_CHECKSUM_SEED 0xcbf29ce484222325ull
+#define FIB_CHECKSUM_PRIME 0x100000001b3ull
+
+// 64-bit FNV-1a, fed a word at a time instead of a byte at a time.
+// Only meant to catch truncated or corrupted files, not tampering.
+static inline uint64_t fib_checksum(void const *const data, size_t const length)
+{
+    uint8_t const *bytes = data;
+    uint64_t hash = FIB_CHECKSUM_SEED ^ length;
+
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= length; offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, &bytes[offset], sizeof(word));
+        hash = (hash ^ word) * FIB_CHECKSUM_PRIME;
+        hash ^= hash >> 29;
+    }
+    for (; offset < length; ++offset)
+    {
+        hash = (hash ^ bytes[offset]) * FIB_CHECKSUM_PRIME;
+    }
+    return hash;
+}
+
+#endif//FIB_CHECKSUM_H
@@ -0,0 +1,33 @@
+#include "fib_control.h"
+
+_Thread_local struct fib_control *fib_control_current;
+
+void fib_control_attach(struct fib_control *control)
+{
+    fib_control_current = control;
+}
+
+int fib_progress(uint64_t done, uint64_t total)
+{
+    struct fib_control *const control = fib_control_current;
+    if (!control)
+    {
+        return 0;
+    }
+
+    atomic_store_explicit(&control->done, done, memory_order_relaxed);
+    atomic_store_explicit(&control->total, total, memory_order_relaxed);
+
+    struct timespec const *deadline = &control->deadline;
+    if (deadline->tv_sec || deadline->tv_nsec)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline->tv_sec
+            || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec))
+        {
+            atomic_store_explicit(&control->cancel, 1, memory_order_relaxed);
+        }
+    }
+    return atomic_load_explicit(&control->cancel, memory_order_relaxed);
+}
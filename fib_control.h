@@ -0,0 +1,45 @@
+#ifndef FIB_CONTROL_H
+#define FIB_CONTROL_H
+
+#include "fib_base.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+// Cooperative cancellation and progress reporting for fibonacci().
+//
+// A caller attaches a struct fib_control to the thread that will compute.
+// The impls call fib_progress() between steps (doubling steps, or every so
+// many additions); it records how far they got and checks the deadline.
+// Long multiplications poll fib_cancelled() between rows, which only looks
+// at the cancel flag. Once either says stop, fibonacci() frees what it
+// allocated and returns { NULL, 0 }.
+//
+// Progress is in bits of the index for the doubling impls and in additions
+// for the linear one; total is 0 when an impl cannot tell (naive).
+
+struct fib_control {
+    struct timespec deadline;       // CLOCK_MONOTONIC, { 0, 0 } for none
+    atomic_int cancel;              // may be set from any thread
+    atomic_uint_least64_t done;
+    atomic_uint_least64_t total;
+};
+
+// control block of the calling thread, NULL if none
+extern _Thread_local struct fib_control *fib_control_current;
+
+// Attaches control (or detaches, for NULL) to the calling thread.
+void fib_control_attach(struct fib_control *control);
+
+// Records progress, sets cancel if the deadline has passed, and returns
+// nonzero if the computation should stop.
+int fib_progress(uint64_t done, uint64_t total);
+
+// Cheap check for inner loops: nonzero once cancel is set.
+static inline int fib_cancelled(void)
+{
+    struct fib_control *const control = fib_control_current;
+    return control && atomic_load_explicit(&control->cancel, memory_order_relaxed);
+}
+
+#endif//FIB_CONTROL_H
@@ -0,0 +1,120 @@
+#include "fib_decimal.h"
+
+#include <gmp.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define LEAF FIB_DECIMAL_LEAF_DIGITS
+
+// x, consumed, written as exactly LEAF << level digits at out
+struct subtree {
+    mpz_t x;
+    mpz_t const *powers;    // powers[i] = 10^(LEAF << i)
+    unsigned level;
+    char *out;
+    unsigned nthreads;      // threads this subtree may keep busy, its own included
+};
+
+static void convert(struct subtree *t);
+
+static void *run_subtree(void *arg)
+{
+    convert(arg);
+    return NULL;
+}
+
+static void convert(struct subtree *t)
+{
+    size_t const width = (size_t)LEAF << t->level;
+    if (t->level == 0)
+    {
+        // x < 10^LEAF, but mpz_get_str wants mpz_sizeinbase(x, 10) + 2 bytes
+        // and mpz_sizeinbase may be one over
+        char digits[LEAF + 3];
+        mpz_get_str(digits, 10, t->x);
+        size_t const len = strlen(digits);
+        memset(t->out, '0', width - len);
+        memcpy(t->out + width - len, digits, len);
+        mpz_clear(t->x);
+        return;
+    }
+
+    // x = high * 10^(width / 2) + low, both halves padded to width / 2 digits
+    size_t const half = width / 2;
+    struct subtree high = { .powers = t->powers, .level = t->level - 1, .out = t->out, .nthreads = t->nthreads / 2 };
+    struct subtree low = { .powers = t->powers, .level = t->level - 1, .out = t->out + half, .nthreads = t->nthreads - high.nthreads };
+    mpz_inits(high.x, low.x, NULL);
+    mpz_tdiv_qr(high.x, low.x, t->x, t->powers[t->level - 1]);
+    mpz_clear(t->x);
+
+    pthread_t thread;
+    if (high.nthreads && half >= FIB_DECIMAL_THREAD_DIGITS
+        && !pthread_create(&thread, NULL, run_subtree, &high))
+    {
+        convert(&low);
+        pthread_join(thread, NULL);
+    }
+    else
+    {
+        high.nthreads = low.nthreads = t->nthreads;
+        convert(&high);
+        convert(&low);
+    }
+}
+
+char *fib_decimal(struct number n, unsigned nthreads, size_t *length)
+{
+    if (nthreads == 0)
+    {
+        long const ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+
+    struct subtree top = { .level = 0, .nthreads = nthreads };
+    mpz_init(top.x);
+    mpz_import(top.x, n.length, -1, 1, 0, 0, n.bytes);
+
+    // smallest tree with room for every digit (sizeinbase may be one over)
+    size_t const digits = mpz_sizeinbase(top.x, 10);
+    while (((size_t)LEAF << top.level) < digits)
+    {
+        ++top.level;
+    }
+
+    mpz_t *powers = malloc((top.level ? top.level : 1) * sizeof(mpz_t));
+    for (unsigned i = 0; i < top.level; ++i)
+    {
+        mpz_init(powers[i]);
+        if (i == 0)
+        {
+            mpz_ui_pow_ui(powers[0], 10, LEAF);
+        }
+        else
+        {
+            mpz_mul(powers[i], powers[i - 1], powers[i - 1]);
+        }
+    }
+    top.powers = (mpz_t const *)powers;
+
+    size_t const width = (size_t)LEAF << top.level;
+    char *out = malloc(width + 1);
+    top.out = out;
+    convert(&top);
+
+    for (unsigned i = 0; i < top.level; ++i)
+    {
+        mpz_clear(powers[i]);
+    }
+    free(powers);
+
+    // drop the padding in front, keeping a single 0 for zero
+    size_t skip = 0;
+    while (skip + 1 < width && out[skip] == '0')
+    {
+        ++skip;
+    }
+    *length = width - skip;
+    memmove(out, out + skip, *length);
+    out[*length] = '\0';
+    return out;
+}
@@ -0,0 +1,31 @@
+#ifndef FIB_DECIMAL_H
+#define FIB_DECIMAL_H
+
+#include "fib_base.h"
+#include "fib_thresholds.h"
+
+// Decimal conversion of a result, divide and conquer.
+//
+// The number is split by 10^(B * 2^level) for a precomputed tree of powers,
+// B = FIB_DECIMAL_LEAF_DIGITS: quotient and remainder are converted into the
+// two halves of the output separately, down to leaves of B digits. GMP's
+// division is subquadratic (Newton, on top of its fast multiplication), so
+// the whole conversion is too. The top levels of the tree hand one half to
+// a new thread, and every part is written straight to its final place in
+// the output, zero-padded.
+
+#ifndef FIB_DECIMAL_LEAF_DIGITS
+#   define FIB_DECIMAL_LEAF_DIGITS 4096
+#endif
+
+// below this many digits a subtree is not worth a thread of its own
+#ifndef FIB_DECIMAL_THREAD_DIGITS
+#   define FIB_DECIMAL_THREAD_DIGITS (1 << 20)
+#endif
+
+// Returns the digits of n (little-endian bytes) as a malloc'ed,
+// NUL-terminated string without leading zeros, and its length in *length.
+// Uses up to nthreads threads, or one per online CPU if nthreads is 0.
+char *fib_decimal(struct number n, unsigned nthreads, size_t *length);
+
+#endif//FIB_DECIMAL_H
@@ -0,0 +1,308 @@
+#include "fib_dispatch.h"
+#include "fib_control.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define NONE (-1)
+#define MAX_SEEDS 64
+
+struct regime {
+    double estimate[FIB_DISPATCH_MAX_CANDIDATES];   // ns per index unit, < 0 if unknown
+    uint64_t samples[FIB_DISPATCH_MAX_CANDIDATES];
+    uint64_t calls;
+    uint64_t explorations;
+    int choice;                                     // NONE before the first call
+    int seeded;                                     // choice from fib_dispatch_seed()
+    unsigned cursor;                                // next challenger to consider
+};
+
+struct fib_dispatch {
+    pthread_mutex_t lock;
+    struct fib_impl const *const *candidates;
+    unsigned n;
+    struct regime regimes[FIB_DISPATCH_REGIMES];
+};
+
+static unsigned regime_of(uint64_t index)
+{
+    return index ? 64 - __builtin_clzll(index) : 0;
+}
+
+// latency is compared per index unit, so that indices across a regime
+// (up to twice apart) weigh alike
+static double units(uint64_t index)
+{
+    return (double)index + 64;
+}
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+struct fib_dispatch *fib_dispatch_create(struct fib_impl const *const *candidates, unsigned n)
+{
+    if (n == 0 || n > FIB_DISPATCH_MAX_CANDIDATES)
+    {
+        return NULL;
+    }
+    struct fib_dispatch *d = calloc(1, sizeof(*d));
+    if (!d)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    d->candidates = candidates;
+    d->n = n;
+    for (unsigned r = 0; r < FIB_DISPATCH_REGIMES; ++r)
+    {
+        d->regimes[r].choice = NONE;
+        for (unsigned c = 0; c < n; ++c)
+        {
+            d->regimes[r].estimate[c] = -1;
+        }
+    }
+    fib_dispatch_seed(d, FIB_DISPATCH_SEEDS);
+    return d;
+}
+
+void fib_dispatch_destroy(struct fib_dispatch *dispatch)
+{
+    if (dispatch)
+    {
+        pthread_mutex_destroy(&dispatch->lock);
+        free(dispatch);
+    }
+}
+
+int fib_dispatch_seed(struct fib_dispatch *d, char const *seeds)
+{
+    // parsed first, so a malformed list changes nothing
+    int choices[MAX_SEEDS];
+    uint64_t firsts[MAX_SEEDS];
+    unsigned count = 0;
+    for (char const *p = seeds; *p;)
+    {
+        size_t const length = strcspn(p, ":,");
+        if (p[length] != ':' || count == MAX_SEEDS)
+        {
+            return -1;
+        }
+        char *end;
+        firsts[count] = strtoull(p + length + 1, &end, 10);
+        if (end == p + length + 1 || (*end && *end != ','))
+        {
+            return -1;
+        }
+        choices[count] = NONE;
+        for (unsigned c = 0; c < d->n; ++c)
+        {
+            if (strlen(d->candidates[c]->name) == length && !strncmp(d->candidates[c]->name, p, length))
+            {
+                choices[count] = c;
+            }
+        }
+        ++count;
+        p = *end ? end + 1 : end;
+    }
+
+    int seeded = 0;
+    pthread_mutex_lock(&d->lock);
+    for (unsigned r = 0; r < FIB_DISPATCH_REGIMES; ++r)
+    {
+        struct regime *reg = &d->regimes[r];
+        if (reg->calls)
+        {
+            continue;
+        }
+        uint64_t const low = r ? 1ull << (r - 1) : 0;
+        uint64_t const middle = low + (low >> 1);
+        int choice = NONE;
+        uint64_t from = 0;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (choices[i] != NONE && firsts[i] <= middle && (choice == NONE || firsts[i] >= from))
+            {
+                choice = choices[i];
+                from = firsts[i];
+            }
+        }
+        reg->choice = choice;
+        reg->seeded = choice != NONE;
+        seeded += reg->seeded;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return seeded;
+}
+
+// whether candidate c is worth a try in regime r: untried, close behind the
+// choice, or the choice of a neighbouring regime (a crossover); the others
+// only on a wide exploration (lock held)
+static int eligible(struct fib_dispatch const *d, unsigned r, unsigned c, int wide)
+{
+    struct regime const *reg = &d->regimes[r];
+    if (wide || reg->estimate[c] < 0
+        || reg->estimate[c] <= FIB_DISPATCH_EXPLORE_SLACK * reg->estimate[reg->choice])
+    {
+        return 1;
+    }
+    return (r > 0 && d->regimes[r - 1].choice == (int)c)
+        || (r + 1 < FIB_DISPATCH_REGIMES && d->regimes[r + 1].choice == (int)c);
+}
+
+// next challenger for regime r, NONE if there is none (lock held)
+static int challenger(struct fib_dispatch *d, unsigned r)
+{
+    struct regime *reg = &d->regimes[r];
+    int const wide = ++reg->explorations % FIB_DISPATCH_EXPLORE_PERIOD == 0;
+    for (unsigned tried = 0; tried < d->n; ++tried)
+    {
+        unsigned const c = reg->cursor++ % d->n;
+        if ((int)c != reg->choice && eligible(d, r, c, wide))
+        {
+            return c;
+        }
+    }
+    return NONE;
+}
+
+// folds a sample in and reconsiders the choice (lock held)
+static void record(struct fib_dispatch *d, unsigned r, unsigned c, double per_unit)
+{
+    struct regime *reg = &d->regimes[r];
+    reg->estimate[c] = reg->estimate[c] < 0
+        ? per_unit
+        : (1 - FIB_DISPATCH_DECAY) * reg->estimate[c] + FIB_DISPATCH_DECAY * per_unit;
+    ++reg->samples[c];
+
+    int best = reg->choice;
+    for (unsigned k = 0; k < d->n; ++k)
+    {
+        if (reg->estimate[k] >= 0 && (best == NONE || reg->estimate[k] < reg->estimate[best]))
+        {
+            best = k;
+        }
+    }
+    if (reg->choice == NONE || reg->estimate[reg->choice] < 0
+        || reg->estimate[best] < (1 - FIB_DISPATCH_MARGIN) * reg->estimate[reg->choice])
+    {
+        reg->choice = best;
+    }
+}
+
+struct number fib_dispatch(struct fib_dispatch *d, uint64_t index)
+{
+    unsigned const r = regime_of(index);
+    struct regime *reg = &d->regimes[r];
+
+    pthread_mutex_lock(&d->lock);
+    if (reg->choice == NONE)
+    {
+        // start from what served the regime below
+        reg->choice = r && d->regimes[r - 1].choice != NONE ? d->regimes[r - 1].choice : 0;
+    }
+    int const choice = reg->choice;
+    // a new regime tries every candidate once right after its first call,
+    // rather than serving a bad inherited choice for a whole period; a
+    // seeded one starts from a measured choice
+    ++reg->calls;
+    int const explore = reg->calls > 1
+        && ((!reg->seeded && reg->calls <= d->n) || reg->calls % FIB_DISPATCH_EXPLORE_PERIOD == 0)
+        ? challenger(d, r)
+        : NONE;
+    double const expected = reg->estimate[choice] >= 0 ? reg->estimate[choice] * units(index) : 0;   // 0: unknown yet
+    pthread_mutex_unlock(&d->lock);
+
+    if (explore != NONE)
+    {
+        // bounded, so a slow challenger costs the caller a bounded delay
+        double const limit = FIB_DISPATCH_EXPLORE_LIMIT * expected > FIB_DISPATCH_EXPLORE_MIN_NS
+            ? FIB_DISPATCH_EXPLORE_LIMIT * expected
+            : FIB_DISPATCH_EXPLORE_MIN_NS;
+        struct fib_control control = { .cancel = 0 };
+        struct fib_control *const outer = fib_control_current;
+        clock_gettime(CLOCK_MONOTONIC, &control.deadline);
+        control.deadline.tv_sec += (time_t)(limit / 1e9);
+        control.deadline.tv_nsec += (long)(limit - (double)(time_t)(limit / 1e9) * 1e9);
+        if (control.deadline.tv_nsec >= 1000000000)
+        {
+            control.deadline.tv_sec += 1;
+            control.deadline.tv_nsec -= 1000000000;
+        }
+
+        fib_control_attach(&control);
+        double const start = now_ns();
+        struct number result = d->candidates[explore]->fibonacci(index);
+        double const elapsed = now_ns() - start;
+        fib_control_attach(outer);
+
+        pthread_mutex_lock(&d->lock);
+        // a cancelled run counts as taking its whole allowance
+        record(d, r, explore, (result.bytes ? elapsed : limit) / units(index));
+        pthread_mutex_unlock(&d->lock);
+        if (result.bytes)
+        {
+            return result;
+        }
+    }
+
+    double const start = now_ns();
+    struct number result = d->candidates[choice]->fibonacci(index);
+    double const elapsed = now_ns() - start;
+    if (result.bytes)
+    {
+        pthread_mutex_lock(&d->lock);
+        record(d, r, choice, elapsed / units(index));
+        pthread_mutex_unlock(&d->lock);
+    }
+    return result;
+}
+
+char const *fib_dispatch_choice(struct fib_dispatch *d, uint64_t index)
+{
+    pthread_mutex_lock(&d->lock);
+    int const choice = d->regimes[regime_of(index)].choice;
+    pthread_mutex_unlock(&d->lock);
+    return choice == NONE ? NULL : d->candidates[choice]->name;
+}
+
+void fib_dispatch_dump(struct fib_dispatch *d, FILE *out)
+{
+    pthread_mutex_lock(&d->lock);
+    fprintf(out, "#             indices              | choice        ");
+    for (unsigned c = 0; c < d->n; ++c)
+    {
+        fprintf(out, " | %-22s", d->candidates[c]->name);
+    }
+    fputc('\n', out);
+
+    for (unsigned r = 0; r < FIB_DISPATCH_REGIMES; ++r)
+    {
+        struct regime const *reg = &d->regimes[r];
+        if (reg->calls == 0)
+        {
+            continue;
+        }
+        uint64_t const low = r ? 1ull << (r - 1) : 0;
+        uint64_t const high = r ? (r == 64 ? UINT64_MAX : (1ull << r) - 1) : 0;
+        fprintf(out, "%20llu-%-13llu | %-14s",
+            (long long unsigned)low, (long long unsigned)high, d->candidates[reg->choice]->name);
+        for (unsigned c = 0; c < d->n; ++c)
+        {
+            if (reg->estimate[c] < 0)
+            {
+                fprintf(out, " | %-22s", "-");
+            }
+            else
+            {
+                fprintf(out, " | %10.3f ns (%7llu)", reg->estimate[c], (long long unsigned)reg->samples[c]);
+            }
+        }
+        fputc('\n', out);
+    }
+    pthread_mutex_unlock(&d->lock);
+}
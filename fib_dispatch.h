@@ -0,0 +1,97 @@
+#ifndef FIB_DISPATCH_H
+#define FIB_DISPATCH_H
+
+#include "fib_base.h"
+#include "fib_registry.h"
+#include "fib_thresholds.h"
+
+#include <stdio.h>
+
+// Self-tuning choice between competing impls, made while serving calls.
+//
+// Indices are split into regimes by bit length. Each regime keeps, per
+// candidate, a decayed average of the latency per index unit, and serves
+// calls with the candidate whose average is lowest; a new regime starts with
+// the choice of the one below, and its next calls try the other candidates
+// once each. From then on, every FIB_DISPATCH_EXPLORE_PERIOD-th call in a
+// regime is served by a challenger
+// instead: one not tried there yet, one within FIB_DISPATCH_EXPLORE_SLACK of
+// the choice, or the choice of a neighbouring regime, so that exploration
+// stays near the crossovers; candidates far behind only get every
+// FIB_DISPATCH_EXPLORE_PERIOD-th exploration. A challenger runs with a
+// deadline of FIB_DISPATCH_EXPLORE_LIMIT times the expected latency, and the
+// call is served by the current choice if it runs out. The choice only moves
+// when a challenger is faster by more than FIB_DISPATCH_MARGIN.
+//
+// Regimes can be seeded with a choice instead, from the crossovers of
+// earlier measurements (`make fit` writes FIB_DISPATCH_SEEDS to fib_fit.h):
+// a seeded regime starts with it and skips the first round of tries, so
+// only the periodic explorations move it.
+//
+// The dispatcher's own state is safe to use from several threads, but calls
+// from several threads run the candidates concurrently, so each of them
+// must be reentrant. The registry impls are (gmp takes a lock around its
+// memo); an impl with unguarded shared state needs one of its own.
+
+// calls between two explorations, per regime
+#ifndef FIB_DISPATCH_EXPLORE_PERIOD
+#   define FIB_DISPATCH_EXPLORE_PERIOD 16
+#endif
+// weight of a new sample in the decayed average
+#ifndef FIB_DISPATCH_DECAY
+#   define FIB_DISPATCH_DECAY 0.125
+#endif
+// relative gain a challenger needs to take over
+#ifndef FIB_DISPATCH_MARGIN
+#   define FIB_DISPATCH_MARGIN 0.05
+#endif
+// cancellation deadline of an exploring call, relative to the choice
+#ifndef FIB_DISPATCH_EXPLORE_LIMIT
+#   define FIB_DISPATCH_EXPLORE_LIMIT 4.0
+#endif
+// floor of that deadline, in ns: below it, checking the clock costs more
+// than the call
+#ifndef FIB_DISPATCH_EXPLORE_MIN_NS
+#   define FIB_DISPATCH_EXPLORE_MIN_NS 100000.0
+#endif
+// how much slower than the choice a candidate may be and still be explored
+// at the normal rate
+#ifndef FIB_DISPATCH_EXPLORE_SLACK
+#   define FIB_DISPATCH_EXPLORE_SLACK 2.0
+#endif
+
+// "name:first_index,..." in increasing order, each impl the fastest from its
+// first index on; names that are not candidates are skipped
+#ifndef FIB_DISPATCH_SEEDS
+#   define FIB_DISPATCH_SEEDS ""
+#endif
+
+#define FIB_DISPATCH_REGIMES 65     // bit lengths 0 to 64
+#define FIB_DISPATCH_MAX_CANDIDATES 16
+
+struct fib_dispatch;
+
+// Dispatcher over candidates[0, n), which must outlive it, seeded with
+// FIB_DISPATCH_SEEDS. Returns NULL if n is 0 or over
+// FIB_DISPATCH_MAX_CANDIDATES.
+struct fib_dispatch *fib_dispatch_create(struct fib_impl const *const *candidates, unsigned n);
+void fib_dispatch_destroy(struct fib_dispatch *dispatch);
+
+// Seeds the regimes not called yet from seeds, in FIB_DISPATCH_SEEDS's
+// format, replacing their earlier seeds: each takes the impl in force at
+// the middle of its index range ("" unseeds them). Returns how many regimes
+// were seeded, or -1 (nothing changed) if seeds is malformed.
+int fib_dispatch_seed(struct fib_dispatch *dispatch, char const *seeds);
+
+// F(index), computed by the current choice (or an exploring challenger).
+struct number fib_dispatch(struct fib_dispatch *dispatch, uint64_t index);
+
+// Name of the candidate that would serve index now, NULL before any call in
+// its regime unless it was seeded.
+char const *fib_dispatch_choice(struct fib_dispatch *dispatch, uint64_t index);
+
+// Prints the state of every regime called so far: its index range, choice,
+// and each candidate's average (ns per index) and sample count.
+void fib_dispatch_dump(struct fib_dispatch *dispatch, FILE *out);
+
+#endif//FIB_DISPATCH_H
@@ -0,0 +1,153 @@
+#include "fib_file.h"
+#include "fib_checksum.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ROUND_UP(x, align) (((x) + (align) - 1) / (align) * (align))
+
+static uint32_t host_endianness(void)
+{
+    uint16_t const aabb = 0xAABB;
+    return *(uint8_t const *)&aabb == 0xBB ? FIB_FILE_LITTLE : FIB_FILE_BIG;
+}
+
+static uint64_t header_checksum(struct fib_file_header const *header)
+{
+    return fib_checksum(header, offsetof(struct fib_file_header, header_checksum));
+}
+
+static int write_all(int fd, void const *buf, size_t len, uint64_t offset)
+{
+    uint8_t const *bytes = buf;
+    while (len)
+    {
+        ssize_t written = pwrite(fd, bytes, len, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        bytes += written;
+        offset += written;
+        len -= written;
+    }
+    return 0;
+}
+
+int fib_file_write(char const *path, uint64_t index, struct number n)
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    size_t const payload_size = ROUND_UP(n.length, FIB_FILE_LIMB_SIZE);
+    uint8_t padding[FIB_FILE_LIMB_SIZE] = { 0 };
+
+    struct fib_file_header header = {
+        .magic = FIB_FILE_MAGIC,
+        .version = FIB_FILE_VERSION,
+        .limb_size = FIB_FILE_LIMB_SIZE,
+        .endianness = host_endianness(),
+        .byte_order = FIB_FILE_BYTE_ORDER,
+        .index = index,
+        .length = n.length,
+        .payload_offset = FIB_FILE_PAYLOAD_OFFSET,
+        .payload_size = payload_size,
+        .checksum = fib_checksum(n.bytes, n.length),
+    };
+    header.header_checksum = header_checksum(&header);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (ftruncate(fd, FIB_FILE_PAYLOAD_OFFSET + payload_size)
+            || write_all(fd, &header, sizeof(header), 0)
+            || write_all(fd, n.bytes, n.length, FIB_FILE_PAYLOAD_OFFSET)
+            || write_all(fd, padding, payload_size - n.length, FIB_FILE_PAYLOAD_OFFSET + n.length)
+            || fsync(fd))
+    {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    if (close(fd) || rename(tmp_path, path))
+    {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int fib_file_open(struct fib_file *file, char const *path)
+{
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < FIB_FILE_PAYLOAD_OFFSET)
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    struct fib_file_header const *header = map;
+    if (memcmp(header->magic, FIB_FILE_MAGIC, sizeof(FIB_FILE_MAGIC))
+            || header->version != FIB_FILE_VERSION
+            || header->header_checksum != header_checksum(header)
+            || header->byte_order != FIB_FILE_BYTE_ORDER
+            || header->endianness != host_endianness()
+            || header->limb_size != FIB_FILE_LIMB_SIZE
+            || header->payload_offset % FIB_FILE_PAYLOAD_OFFSET
+            || header->payload_size % FIB_FILE_LIMB_SIZE
+            || header->length > header->payload_size
+            || header->payload_offset + header->payload_size > (uint64_t)st.st_size)
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    file->map = map;
+    file->size = st.st_size;
+    file->header = header;
+    return 0;
+}
+
+void fib_file_close(struct fib_file *file)
+{
+    if (file->map)
+    {
+        munmap((void *)file->map, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+int fib_file_check(struct fib_file const *file)
+{
+    uint8_t const *payload = (uint8_t const *)file->map + file->header->payload_offset;
+
+    // the padding is not hashed, but the mpz_t view reads it
+    for (uint64_t i = file->header->length; i < file->header->payload_size; ++i)
+    {
+        if (payload[i]) { return -1; }
+    }
+    return fib_checksum(payload, file->header->length) == file->header->checksum ? 0 : -1;
+}
@@ -0,0 +1,87 @@
+#ifndef FIB_FILE_H
+#define FIB_FILE_H
+
+#include "fib_base.h"
+
+// Self-describing binary file holding one result, F(index).
+//
+// The header records the index, the limb size and endianness of the
+// payload, its length and checksum. The payload starts on a page boundary
+// and is zero-padded to whole limbs, so a reader maps the file and uses the
+// payload in place, as a struct number or (with GMP) as a read-only mpz_t,
+// without parsing anything. Like the store, files are only read back on a
+// machine with the same endianness and limb size.
+//
+// Layout:
+//   struct fib_file_header, zero-padded to FIB_FILE_PAYLOAD_OFFSET
+//   payload: length bytes, little-endian on little-endian machines,
+//            zero-padded to a multiple of limb_size
+
+#define FIB_FILE_MAGIC "FIBNUM"
+#define FIB_FILE_VERSION 1
+#define FIB_FILE_BYTE_ORDER 0x0102030405060708ull
+#define FIB_FILE_PAYLOAD_OFFSET 4096
+#define FIB_FILE_LIMB_SIZE 8
+
+// endianness, as check_endian.c reports it
+enum fib_file_endianness {
+    FIB_FILE_LITTLE = 1,
+    FIB_FILE_BIG = 2,
+};
+
+struct fib_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t limb_size;         // bytes
+    uint32_t endianness;        // of the payload limbs and this header
+    uint32_t reserved;
+    uint64_t byte_order;        // FIB_FILE_BYTE_ORDER as the writer stored it
+    uint64_t index;
+    uint64_t length;            // bytes of the value, without padding
+    uint64_t payload_offset;
+    uint64_t payload_size;      // length rounded up to whole limbs
+    uint64_t checksum;          // of the length bytes of the value
+    uint64_t header_checksum;   // of everything above
+};
+
+struct fib_file {
+    void const *map;
+    size_t size;
+    struct fib_file_header const *header;
+};
+
+// Writes n as F(index) to path, through a temporary file renamed into place.
+// Returns 0 on success, -1 on failure.
+int fib_file_write(char const *path, uint64_t index, struct number n);
+
+// Maps the file at path and validates its header. Returns 0 on success, -1
+// if the file is missing, truncated, from another version or written on a
+// machine with another endianness or limb size.
+int fib_file_open(struct fib_file *file, char const *path);
+void fib_file_close(struct fib_file *file);
+
+// Recomputes the payload checksum and checks the padding is zero.
+// Returns 0 if both hold, -1 otherwise.
+int fib_file_check(struct fib_file const *file);
+
+// Read-only view of the value, valid until fib_file_close().
+static inline struct number fib_file_number(struct fib_file const *file)
+{
+    return (struct number){
+        (uint8_t *)file->map + file->header->payload_offset,
+        file->header->length,
+    };
+}
+
+#ifdef __GNU_MP__
+// Read-only mpz_t view of the value, valid until fib_file_close().
+// Only for reading: GMP must never reallocate or free it.
+static inline mpz_srcptr fib_file_mpz(struct fib_file const *file, mpz_ptr view)
+{
+    return mpz_roinit_n(view,
+        (mp_limb_t const *)((uint8_t const *)file->map + file->header->payload_offset),
+        file->header->payload_size / sizeof(mp_limb_t));
+}
+#endif
+
+#endif//FIB_FILE_H
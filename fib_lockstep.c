@@ -0,0 +1,284 @@
+#include "fib_lockstep.h"
+
+#if defined(__AVX512F__) && defined(__AVX512IFMA__)
+#   include <immintrin.h>
+#   define LANES 8
+#   define LIMB_BITS 52
+
+typedef __m512i vec;
+typedef __mmask8 lanemask;
+
+static inline vec vec_zero(void) { return _mm512_setzero_si512(); }
+static inline vec vec_add(vec a, vec b) { return _mm512_add_epi64(a, b); }
+static inline vec vec_low(vec a) { return _mm512_and_si512(a, _mm512_set1_epi64((1ull << LIMB_BITS) - 1)); }
+static inline vec vec_high(vec a) { return _mm512_srli_epi64(a, LIMB_BITS); }
+static inline lanemask vec_mask(unsigned bits) { return (lanemask)bits; }
+static inline vec vec_select(lanemask m, vec if_set, vec if_clear) { return _mm512_mask_blend_epi64(m, if_clear, if_set); }
+
+// lo += low LIMB_BITS of a * b, hi += the next LIMB_BITS
+static inline void vec_madd(vec *lo, vec *hi, vec a, vec b)
+{
+    *lo = _mm512_madd52lo_epu64(*lo, a, b);
+    *hi = _mm512_madd52hi_epu64(*hi, a, b);
+}
+
+#elif defined(__AVX2__)
+#   include <immintrin.h>
+#   define LANES 4
+#   define LIMB_BITS 32
+
+typedef __m256i vec;
+typedef __m256i lanemask;
+
+static inline vec vec_zero(void) { return _mm256_setzero_si256(); }
+static inline vec vec_add(vec a, vec b) { return _mm256_add_epi64(a, b); }
+static inline vec vec_low(vec a) { return _mm256_and_si256(a, _mm256_set1_epi64x((1ull << LIMB_BITS) - 1)); }
+static inline vec vec_high(vec a) { return _mm256_srli_epi64(a, LIMB_BITS); }
+static inline lanemask vec_mask(unsigned bits)
+{
+    return _mm256_set_epi64x(-(long long)(bits >> 3 & 1), -(long long)(bits >> 2 & 1),
+                             -(long long)(bits >> 1 & 1), -(long long)(bits & 1));
+}
+static inline vec vec_select(lanemask m, vec if_set, vec if_clear) { return _mm256_blendv_epi8(if_clear, if_set, m); }
+
+static inline void vec_madd(vec *lo, vec *hi, vec a, vec b)
+{
+    vec const prod = _mm256_mul_epu32(a, b);
+    *lo = vec_add(*lo, vec_low(prod));
+    *hi = vec_add(*hi, vec_high(prod));
+}
+
+#else
+#   define LANES 4
+#   define LIMB_BITS 32
+
+typedef struct { uint64_t v[LANES]; } vec;
+typedef unsigned lanemask;
+
+#   define VEC_MAP(expr) vec r; for (int l = 0; l < LANES; ++l) { r.v[l] = (expr); } return r
+static inline vec vec_zero(void) { VEC_MAP(0); }
+static inline vec vec_add(vec a, vec b) { VEC_MAP(a.v[l] + b.v[l]); }
+static inline vec vec_low(vec a) { VEC_MAP(a.v[l] & ((1ull << LIMB_BITS) - 1)); }
+static inline vec vec_high(vec a) { VEC_MAP(a.v[l] >> LIMB_BITS); }
+static inline lanemask vec_mask(unsigned bits) { return bits; }
+static inline vec vec_select(lanemask m, vec if_set, vec if_clear) { VEC_MAP(m >> l & 1 ? if_set.v[l] : if_clear.v[l]); }
+
+static inline void vec_madd(vec *lo, vec *hi, vec a, vec b)
+{
+    for (int l = 0; l < LANES; ++l)
+    {
+        uint64_t const prod = a.v[l] * b.v[l];
+        lo->v[l] += prod & ((1ull << LIMB_BITS) - 1);
+        hi->v[l] += prod >> LIMB_BITS;
+    }
+}
+#endif
+
+unsigned const fib_lockstep_lanes = LANES;
+
+// enough limbs for F(n), from log2(phi) < 711/1024
+static size_t nlimb_estimate(uint64_t const n)
+{
+    return (n * 711 / 1024 + 1) / LIMB_BITS + 1;
+}
+
+// out = low n limbs of the normalized sum of the lo and hi columns
+static void normalize(vec *restrict out, vec const *lo, vec const *hi, size_t n)
+{
+    vec carry = vec_zero();
+    for (size_t k = 0; k < n; ++k)
+    {
+        vec const v = vec_add(vec_add(lo[k], hi[k]), carry);
+        out[k] = vec_low(v);
+        carry = vec_high(v);
+    }
+}
+
+// out = x + x + y if twice, else x + y
+static void add(vec *restrict out, vec const *x, vec const *y, int twice, size_t n)
+{
+    vec carry = vec_zero();
+    for (size_t k = 0; k < n; ++k)
+    {
+        vec v = vec_add(vec_add(x[k], y[k]), carry);
+        if (twice) { v = vec_add(v, x[k]); }
+        out[k] = vec_low(v);
+        carry = vec_high(v);
+    }
+}
+
+// accumulates the low n limbs of x * y into the lo and hi columns
+// (every value in the recurrence fits in n limbs, so the rest is zero)
+static void mul_acc(vec *lo, vec *hi, vec const *x, vec const *y, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        vec const xi = x[i];
+        for (size_t j = 0; i + j < n; ++j)
+        {
+            // the columns have one spare slot for the products landing at n
+            vec_madd(&lo[i + j], &hi[i + j + 1], xi, y[j]);
+        }
+    }
+}
+
+// accumulates the low n limbs of x^2 + y^2 into the lo and hi columns,
+// computing each cross product once and doubling the columns
+static void sqr2_acc(vec *lo, vec *hi, vec const *x, vec const *y, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        vec const xi = x[i];
+        vec const yi = y[i];
+        for (size_t j = i + 1; i + j < n; ++j)
+        {
+            vec_madd(&lo[i + j], &hi[i + j + 1], xi, x[j]);
+            vec_madd(&lo[i + j], &hi[i + j + 1], yi, y[j]);
+        }
+    }
+    for (size_t k = 0; k <= n; ++k)
+    {
+        lo[k] = vec_add(lo[k], lo[k]);
+        hi[k] = vec_add(hi[k], hi[k]);
+    }
+    for (size_t i = 0; 2 * i < n; ++i)
+    {
+        vec_madd(&lo[2 * i], &hi[2 * i + 1], x[i], x[i]);
+        vec_madd(&lo[2 * i], &hi[2 * i + 1], y[i], y[i]);
+    }
+}
+
+// F(indices[l]) for l < LANES in lockstep; unused lanes carry index 0
+static void lockstep(uint64_t const *indices, struct number *outputs, unsigned used)
+{
+    uint64_t max_index = 0;
+    for (unsigned l = 0; l < LANES; ++l)
+    {
+        max_index = indices[l] > max_index ? indices[l] : max_index;
+    }
+    size_t const nmax = nlimb_estimate(max_index + 2);
+
+    // a = F(m-1), b = F(m), as in impl/fastsquaring.c
+    size_t const nwork = 10 * nmax + 4;
+    vec *const work = aligned_alloc(64, (nwork * sizeof(vec) + 63) / 64 * 64);
+    vec *a = work, *b = &a[nmax], *t = &b[nmax];
+    vec *na = &t[nmax], *nb = &na[nmax], *s = &nb[nmax];
+    vec *lo1 = &s[nmax], *hi1 = &lo1[nmax + 1], *lo2 = &hi1[nmax + 1], *hi2 = &lo2[nmax + 1];
+    for (size_t k = 0; k < nwork; ++k)
+    {
+        work[k] = vec_zero();
+    }
+    uint64_t one[LANES];
+    for (unsigned l = 0; l < LANES; ++l) { one[l] = 1; }
+    memcpy(&a[0], one, sizeof(one));
+
+    for (int bit = max_index ? 63 - __builtin_clzll(max_index) : -1; bit >= 0; --bit)
+    {
+        // the partial indices are at most max_index >> bit
+        size_t const n = nlimb_estimate((max_index >> bit) + 2);
+        for (size_t k = 0; k < n + 1; ++k)
+        {
+            lo1[k] = hi1[k] = lo2[k] = hi2[k] = vec_zero();
+        }
+
+        // F(2m-1) = F(m-1)^2 + F(m)^2
+        // F(2m)   = F(m) * (2F(m-1) + F(m))
+        add(t, a, b, 1, n);
+        sqr2_acc(lo1, hi1, a, b, n);
+        mul_acc(lo2, hi2, b, t, n);
+        normalize(na, lo1, hi1, n);
+        normalize(nb, lo2, hi2, n);
+
+        // lanes with this bit set step on to (F(2m), F(2m+1))
+        unsigned bits = 0;
+        for (unsigned l = 0; l < LANES; ++l)
+        {
+            bits |= (unsigned)(indices[l] >> bit & 1) << l;
+        }
+        lanemask const m = vec_mask(bits);
+        add(s, na, nb, 0, n);
+        for (size_t k = 0; k < n; ++k)
+        {
+            a[k] = vec_select(m, nb[k], na[k]);
+            b[k] = vec_select(m, s[k], nb[k]);
+        }
+    }
+
+    // unpack the LIMB_BITS-bit limbs of each lane into bytes
+    size_t const nbytes = (nmax * LIMB_BITS + CHAR_BIT - 1) / CHAR_BIT;
+    for (unsigned l = 0; l < used; ++l)
+    {
+        uint8_t *bytes = calloc(nbytes + 1, 1);
+        size_t length = 0;
+        __uint128_t pending = 0;
+        unsigned npending = 0;
+        for (size_t k = 0; k < nmax; ++k)
+        {
+            uint64_t limbs[LANES];
+            memcpy(limbs, &b[k], sizeof(limbs));
+            pending |= (__uint128_t)limbs[l] << npending;
+            for (npending += LIMB_BITS; npending >= CHAR_BIT; npending -= CHAR_BIT)
+            {
+                bytes[length++] = (uint8_t)pending;
+                pending >>= CHAR_BIT;
+            }
+        }
+        bytes[length++] = (uint8_t)pending;
+        while (length > 1 && !bytes[length - 1])
+        {
+            --length;
+        }
+        outputs[l] = (struct number){ bytes, length };
+    }
+
+    free(work);
+}
+
+struct lane {
+    uint64_t index;
+    size_t slot;
+};
+
+static int compare_lanes(void const *lhs, void const *rhs)
+{
+    uint64_t const a = ((struct lane const *)lhs)->index;
+    uint64_t const b = ((struct lane const *)rhs)->index;
+    return (a > b) - (a < b);
+}
+
+void fibonacci_lockstep(uint64_t const *indices, size_t count, struct number *outputs)
+{
+    // sorted, so that each group of lanes needs about the same limb count
+    struct lane *lanes = malloc((count ? count : 1) * sizeof(*lanes));
+    size_t nlanes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (indices[i] > FIB_LOCKSTEP_MAX_INDEX)
+        {
+            outputs[i] = fibonacci(indices[i]);
+        }
+        else
+        {
+            lanes[nlanes++] = (struct lane){ indices[i], i };
+        }
+    }
+    qsort(lanes, nlanes, sizeof(*lanes), compare_lanes);
+
+    for (size_t i = 0; i < nlanes; i += LANES)
+    {
+        unsigned const used = nlanes - i < LANES ? nlanes - i : LANES;
+        uint64_t lane_index[LANES] = { 0 };
+        struct number lane_output[LANES];
+        for (unsigned l = 0; l < used; ++l)
+        {
+            lane_index[l] = lanes[i + l].index;
+        }
+        lockstep(lane_index, lane_output, used);
+        for (unsigned l = 0; l < used; ++l)
+        {
+            outputs[lanes[i + l].slot] = lane_output[l];
+        }
+    }
+
+    free(lanes);
+}
@@ -0,0 +1,27 @@
+#ifndef FIB_LOCKSTEP_H
+#define FIB_LOCKSTEP_H
+
+#include "fib_base.h"
+#include "fib_thresholds.h"
+
+// Batch kernel for many small indices.
+//
+// Runs the fast-doubling recurrence for FIB_LOCKSTEP_LANES indices at once,
+// one index per vector lane: 52-bit limbs and IFMA multiplies on AVX-512,
+// 32-bit limbs and 32x32->64 multiplies on AVX2, plain loops otherwise.
+// Lanes whose index has fewer bits start with leading zero bits, which
+// leave the (F(-1), F(0)) starting pair unchanged.
+
+#ifndef FIB_LOCKSTEP_MAX_INDEX
+#   define FIB_LOCKSTEP_MAX_INDEX 8192
+#endif
+
+// number of indices advanced together
+extern unsigned const fib_lockstep_lanes;
+
+// Computes outputs[i] = F(indices[i]) for i < count. Indices above
+// FIB_LOCKSTEP_MAX_INDEX are handed to fibonacci(), so callers using
+// larger indices must link an implementation.
+void fibonacci_lockstep(uint64_t const *indices, size_t count, struct number *outputs);
+
+#endif//FIB_LOCKSTEP_H
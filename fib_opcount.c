@@ -0,0 +1,63 @@
+#include "fib_opcount.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+char const *const fib_opcount_names[FIB_OP_COUNT] = {
+    "limb muls",
+    "limb adds",
+    "bytes zeroed",
+    "bytes copied",
+    "bytes alloc'd",
+};
+
+// one per thread that counted something, never freed: the counts of a
+// thread that exited still add up
+struct block {
+    struct block *next;
+    uint64_t counts[FIB_OP_COUNT];
+};
+
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct block *blocks = NULL;
+
+_Thread_local uint64_t *fib_opcount_own = NULL;
+
+uint64_t *fib_opcount_register(void)
+{
+    struct block *const block = calloc(1, sizeof(*block));
+    if (!block)
+    {
+        return NULL;
+    }
+    pthread_mutex_lock(&blocks_lock);
+    block->next = blocks;
+    blocks = block;
+    pthread_mutex_unlock(&blocks_lock);
+    return fib_opcount_own = block->counts;
+}
+
+void fib_opcount_reset(void)
+{
+    pthread_mutex_lock(&blocks_lock);
+    for (struct block *block = blocks; block; block = block->next)
+    {
+        memset(block->counts, 0, sizeof(block->counts));
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+void fib_opcount_read(uint64_t counts[FIB_OP_COUNT])
+{
+    memset(counts, 0, FIB_OP_COUNT * sizeof(counts[0]));
+    pthread_mutex_lock(&blocks_lock);
+    for (struct block const *block = blocks; block; block = block->next)
+    {
+        for (int i = 0; i < FIB_OP_COUNT; ++i)
+        {
+            counts[i] += block->counts[i];
+        }
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
@@ -0,0 +1,58 @@
+#ifndef FIB_OPCOUNT_H
+#define FIB_OPCOUNT_H
+
+#include <stdint.h>
+
+// Operation counts of fibonacci() calls, for builds with -DOPCOUNT.
+//
+// The native impls count what their kernels do, a call of a kernel at a
+// time: 64-bit limb multiplications, limb additions (one per limb an
+// addition or a multiply-accumulate writes, carry-outs left out), and the
+// bytes they zero (memset, calloc), copy (memcpy) and allocate. Unlike
+// times, these are the same on every machine, so a change in the algorithm
+// shows up on its own. The GMP impls count nothing; their columns read `-`.
+//
+// Each thread counts into a block of its own, helper threads included;
+// fib_opcount_read() sums them, and must not race with counted calls.
+
+enum fib_op {
+    FIB_OP_LIMB_MULS,
+    FIB_OP_LIMB_ADDS,
+    FIB_OP_BYTES_ZEROED,
+    FIB_OP_BYTES_COPIED,
+    FIB_OP_BYTES_ALLOCATED,
+    FIB_OP_COUNT
+};
+
+extern char const *const fib_opcount_names[FIB_OP_COUNT];
+
+#ifdef OPCOUNT
+#   define FIB_OPCOUNT_ENABLED 1
+#   define opcount(op, n) fib_opcount_add(FIB_OP_##op, (n))
+#else
+#   define FIB_OPCOUNT_ENABLED 0
+#   define opcount(op, n)
+#endif
+
+// block of the calling thread, NULL until it counts something
+extern _Thread_local uint64_t *fib_opcount_own;
+
+// Allocates and registers the block of the calling thread.
+uint64_t *fib_opcount_register(void);
+
+static inline void fib_opcount_add(enum fib_op op, uint64_t n)
+{
+    uint64_t *const own = fib_opcount_own ? fib_opcount_own : fib_opcount_register();
+    if (own)
+    {
+        own[op] += n;
+    }
+}
+
+// Zeroes the counts of every thread.
+void fib_opcount_reset(void);
+
+// Sums the counts of every thread into counts.
+void fib_opcount_read(uint64_t counts[FIB_OP_COUNT]);
+
+#endif//FIB_OPCOUNT_H
@@ -0,0 +1,110 @@
+#include "fib_perf.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+char const *const fib_perf_names[FIB_PERF_COUNT] = {
+    "cycles",
+    "instructions",
+    "L1D misses",
+    "LLC misses",
+    "dTLB misses",
+    "branch misses",
+};
+
+#define CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static struct {
+    uint32_t type;
+    uint64_t config;
+} const events[FIB_PERF_COUNT] = {
+    [FIB_PERF_CYCLES]        = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [FIB_PERF_INSTRUCTIONS]  = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [FIB_PERF_L1D_MISSES]    = { PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [FIB_PERF_LLC_MISSES]    = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [FIB_PERF_DTLB_MISSES]   = { PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+    [FIB_PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+int fib_perf_open(struct fib_perf *perf)
+{
+    int opened = 0;
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        perf->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        opened += perf->fd[i] >= 0;
+    }
+    return opened;
+}
+
+void fib_perf_close(struct fib_perf *perf)
+{
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        if (perf->fd[i] >= 0)
+        {
+            close(perf->fd[i]);
+            perf->fd[i] = -1;
+        }
+    }
+}
+
+void fib_perf_start(struct fib_perf *perf)
+{
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        if (perf->fd[i] >= 0)
+        {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void fib_perf_stop(struct fib_perf *perf, uint64_t *values)
+{
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        if (perf->fd[i] >= 0)
+        {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < FIB_PERF_COUNT; ++i)
+    {
+        // value, time enabled, time running
+        uint64_t data[3];
+        values[i] = FIB_PERF_UNAVAILABLE;
+        if (perf->fd[i] < 0 || read(perf->fd[i], data, sizeof(data)) != sizeof(data))
+        {
+            continue;
+        }
+        if (data[2] == 0)
+        {
+            // never scheduled on the PMU
+            values[i] = data[1] ? FIB_PERF_UNAVAILABLE : 0;
+        }
+        else if (data[2] < data[1])
+        {
+            values[i] = (uint64_t)((double)data[0] * data[1] / data[2]);
+        }
+        else
+        {
+            values[i] = data[0];
+        }
+    }
+}
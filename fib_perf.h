@@ -0,0 +1,44 @@
+#ifndef FIB_PERF_H
+#define FIB_PERF_H
+
+#include "fib_base.h"
+
+// Hardware performance counters around a measured call, via perf_event_open.
+//
+// Each counter is opened on its own, user space only, for the calling thread
+// and the threads it creates afterwards. A counter the kernel or the CPU
+// refuses (no PMU in a VM, perf_event_paranoid too high, no such event) is
+// just left out: it reads as FIB_PERF_UNAVAILABLE and the others still
+// count. Counts are scaled up if the kernel had to multiplex them.
+
+enum fib_perf_counter {
+    FIB_PERF_CYCLES,
+    FIB_PERF_INSTRUCTIONS,
+    FIB_PERF_L1D_MISSES,
+    FIB_PERF_LLC_MISSES,
+    FIB_PERF_DTLB_MISSES,
+    FIB_PERF_BRANCH_MISSES,
+    FIB_PERF_COUNT
+};
+
+#define FIB_PERF_UNAVAILABLE UINT64_MAX
+
+// column names, in enum order
+extern char const *const fib_perf_names[FIB_PERF_COUNT];
+
+struct fib_perf {
+    int fd[FIB_PERF_COUNT];
+};
+
+// Opens the counters, disabled, for the calling thread. Returns how many of
+// them could be opened.
+int fib_perf_open(struct fib_perf *perf);
+void fib_perf_close(struct fib_perf *perf);
+
+// Resets and enables the open counters.
+void fib_perf_start(struct fib_perf *perf);
+
+// Disables the counters and reads them into values[FIB_PERF_COUNT].
+void fib_perf_stop(struct fib_perf *perf, uint64_t *values);
+
+#endif//FIB_PERF_H
@@ -0,0 +1,377 @@
+#include "fib_pool.h"
+
+#include <gmp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define DEQUE_CAPACITY 256
+#define SPIN_ROUNDS 2048
+
+struct task {
+    void (*run)(struct task *task);
+};
+
+// ring buffer of tasks: the owner pushes and pops at tail, thieves take head
+struct deque {
+    pthread_mutex_t lock;
+    struct task **tasks;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+static struct {
+    int running;
+    atomic_int stopping;
+    unsigned nworkers;
+    pthread_t *threads;
+    struct deque *requests;     // whole requests, run by idle workers only
+    struct deque *forks;        // products of a doubling step, also run by joins
+    atomic_size_t queued;       // tasks sitting in any deque
+    atomic_uint next_deque;     // round robin for submissions from outside
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle;
+} pool = {
+    .idle_lock = PTHREAD_MUTEX_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local int worker_id = -1;
+
+static void deque_push(struct deque *d, struct task *task)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->capacity)
+    {
+        struct task **tasks = malloc(2 * d->capacity * sizeof(*tasks));
+        for (size_t i = d->head; i < d->tail; ++i)
+        {
+            tasks[i % (2 * d->capacity)] = d->tasks[i % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->capacity *= 2;
+    }
+    d->tasks[d->tail++ % d->capacity] = task;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// pops the newest task
+static struct task *deque_pop(struct deque *d)
+{
+    struct task *task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail != d->head)
+    {
+        task = d->tasks[--d->tail % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static struct task *deque_steal(struct deque *d)
+{
+    struct task *task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail != d->head)
+    {
+        task = d->tasks[d->head++ % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+// onto deques[worker_id], or round robin from outside the pool
+static void push_task(struct deque *deques, struct task *task)
+{
+    unsigned const target = worker_id >= 0
+        ? (unsigned)worker_id
+        : atomic_fetch_add(&pool.next_deque, 1) % pool.nworkers;
+    deque_push(&deques[target], task);
+    atomic_fetch_add(&pool.queued, 1);
+
+    pthread_mutex_lock(&pool.idle_lock);
+    pthread_cond_signal(&pool.idle);
+    pthread_mutex_unlock(&pool.idle_lock);
+}
+
+// own deque of deques first (newest first), then steal round the others
+// (oldest first)
+static struct task *find_task(struct deque *deques)
+{
+    struct task *task = NULL;
+    if (worker_id >= 0)
+    {
+        task = deque_pop(&deques[worker_id]);
+    }
+    for (unsigned i = 1; !task && i <= pool.nworkers; ++i)
+    {
+        unsigned const victim = ((unsigned)(worker_id + 1) + i) % pool.nworkers;
+        task = deque_steal(&deques[victim]);
+    }
+    if (task)
+    {
+        atomic_fetch_sub(&pool.queued, 1);
+    }
+    return task;
+}
+
+static void *worker_main(void *arg)
+{
+    worker_id = (int)(intptr_t)arg;
+    for (;;)
+    {
+        // forks first: a request waits on them
+        struct task *task = find_task(pool.forks);
+        if (!task)
+        {
+            task = find_task(pool.requests);
+        }
+        if (task)
+        {
+            task->run(task);
+            continue;
+        }
+
+        for (unsigned spin = 0; spin < SPIN_ROUNDS && !atomic_load(&pool.queued); ++spin)
+        {
+            __builtin_ia32_pause();
+        }
+
+        pthread_mutex_lock(&pool.idle_lock);
+        while (!atomic_load(&pool.queued) && !atomic_load(&pool.stopping))
+        {
+            pthread_cond_wait(&pool.idle, &pool.idle_lock);
+        }
+        pthread_mutex_unlock(&pool.idle_lock);
+
+        if (atomic_load(&pool.stopping) && !atomic_load(&pool.queued))
+        {
+            return NULL;
+        }
+    }
+}
+
+// Waits for the forks counted by pending to finish, running forks it finds
+// meanwhile: its own may have been stolen by a worker that is itself
+// waiting. Forks are single products, so this never nests a whole request
+// under the one waiting.
+static void join(atomic_int *pending)
+{
+    while (atomic_load_explicit(pending, memory_order_acquire))
+    {
+        struct task *task = find_task(pool.forks);
+        if (task)
+        {
+            task->run(task);
+        }
+        else
+        {
+            __builtin_ia32_pause();
+        }
+    }
+}
+
+static struct number to_number(mpz_t const x)
+{
+    size_t count;
+    void *bytes = mpz_export(NULL, &count, -1, 1, 0, 0, x);
+    if (count == 0)
+    {
+        bytes = calloc(1, 1);
+        count = 1;
+    }
+    return (struct number){ bytes, count };
+}
+
+static void from_number(mpz_t x, struct number n)
+{
+    mpz_import(x, n.length, -1, 1, 0, 0, n.bytes);
+    free(n.bytes);
+}
+
+struct product {
+    struct task task;
+    mpz_ptr result;
+    mpz_srcptr lhs;
+    mpz_srcptr rhs;
+    atomic_int *pending;
+};
+
+static void run_product(struct task *task)
+{
+    struct product *p = (struct product *)task;
+    mpz_mul(p->result, p->lhs, p->rhs);
+    atomic_fetch_sub_explicit(p->pending, 1, memory_order_release);
+}
+
+// F(index) by doubling from F(index >> shift), the first prefix below
+// FIB_POOL_SPLIT_INDEX, with the three products of every step in parallel
+static struct number split_doubling(uint64_t const index)
+{
+    unsigned shift = 0;
+    while ((index >> shift) >= FIB_POOL_SPLIT_INDEX)
+    {
+        ++shift;
+    }
+
+    mpz_t a, b, c, p1, p2, p3;
+    mpz_inits(a, b, c, p1, p2, p3, NULL);
+    from_number(a, fibonacci(index >> shift));
+    from_number(b, fibonacci((index >> shift) + 1));
+
+    while (shift--)
+    {
+        // F(2k) = F(k) * [2 * F(k+1) - F(k)]
+        // F(2k+1) = F(k)^2 + F(k+1)^2
+        mpz_mul_2exp(c, b, 1);
+        mpz_sub(c, c, a);
+
+        atomic_int pending = 2;
+        struct product forks[2] = {
+            { { run_product }, p1, a, c, &pending },
+            { { run_product }, p2, a, a, &pending },
+        };
+        push_task(pool.forks, &forks[0].task);
+        push_task(pool.forks, &forks[1].task);
+        mpz_mul(p3, b, b);
+        join(&pending);
+
+        mpz_add(p2, p2, p3);
+        if (index >> shift & 1)
+        {
+            mpz_add(b, p1, p2);  // b = F(2k+2)
+            mpz_swap(a, p2);     // a = F(2k+1)
+        }
+        else
+        {
+            mpz_swap(a, p1);     // a = F(2k)
+            mpz_swap(b, p2);     // b = F(2k+1)
+        }
+    }
+
+    struct number result = to_number(a);
+    mpz_clears(a, b, c, p1, p2, p3, NULL);
+    return result;
+}
+
+static void complete(struct fib_request *request)
+{
+    // the callback may release the request
+    int const eventfd = request->eventfd;
+    if (request->callback)
+    {
+        request->callback(request);
+    }
+    if (eventfd >= 0)
+    {
+        uint64_t const one = 1;
+        (void)!write(eventfd, &one, sizeof(one));
+    }
+}
+
+struct request_task {
+    struct task task;
+    struct fib_request *request;
+};
+
+static void run_request(struct task *task)
+{
+    struct fib_request *request = ((struct request_task *)task)->request;
+    free(task);
+
+    request->result = request->index < FIB_POOL_SPLIT_INDEX
+        ? fibonacci(request->index)
+        : split_doubling(request->index);
+    complete(request);
+}
+
+int fib_pool_start(unsigned nworkers)
+{
+    if (pool.running)
+    {
+        return -1;
+    }
+    if (nworkers == 0)
+    {
+        long const ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+
+    pool.nworkers = nworkers;
+    pool.threads = calloc(nworkers, sizeof(*pool.threads));
+    pool.requests = calloc(nworkers, sizeof(*pool.requests));
+    pool.forks = calloc(nworkers, sizeof(*pool.forks));
+    atomic_store(&pool.queued, 0);
+    atomic_store(&pool.stopping, 0);
+    for (unsigned i = 0; i < 2 * nworkers; ++i)
+    {
+        struct deque *d = i < nworkers ? &pool.requests[i] : &pool.forks[i - nworkers];
+        pthread_mutex_init(&d->lock, NULL);
+        d->capacity = DEQUE_CAPACITY;
+        d->tasks = malloc(DEQUE_CAPACITY * sizeof(struct task *));
+    }
+    for (unsigned i = 0; i < nworkers; ++i)
+    {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, (void *)(intptr_t)i))
+        {
+            pool.nworkers = i;
+            pool.running = 1;
+            fib_pool_stop();
+            return -1;
+        }
+    }
+    pool.running = 1;
+    return 0;
+}
+
+void fib_pool_stop(void)
+{
+    if (!pool.running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.idle_lock);
+    atomic_store(&pool.stopping, 1);
+    pthread_cond_broadcast(&pool.idle);
+    pthread_mutex_unlock(&pool.idle_lock);
+
+    for (unsigned i = 0; i < pool.nworkers; ++i)
+    {
+        pthread_join(pool.threads[i], NULL);
+    }
+    for (unsigned i = 0; i < 2 * pool.nworkers; ++i)
+    {
+        struct deque *d = i < pool.nworkers ? &pool.requests[i] : &pool.forks[i - pool.nworkers];
+        pthread_mutex_destroy(&d->lock);
+        free(d->tasks);
+    }
+    free(pool.requests);
+    free(pool.forks);
+    free(pool.threads);
+    pool.running = 0;
+}
+
+int fibonacci_submit(struct fib_request *request)
+{
+    if (!pool.running)
+    {
+        return -1;
+    }
+
+    if (request->index < FIB_POOL_INLINE_INDEX)
+    {
+        request->result = fibonacci(request->index);
+        complete(request);
+        return 0;
+    }
+
+    struct request_task *task = malloc(sizeof(*task));
+    task->task.run = run_request;
+    task->request = request;
+    push_task(pool.requests, &task->task);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef FIB_POOL_H
+#define FIB_POOL_H
+
+#include "fib_base.h"
+#include "fib_thresholds.h"
+
+// Asynchronous evaluation on a persistent work-stealing pool.
+//
+// Every worker owns two deques, one of requests and one of forked
+// products: it pushes and pops its own end, idle workers steal from the
+// other end. Small indices are computed inline by fibonacci_submit()
+// itself. Large ones walk the doubling steps above FIB_POOL_SPLIT_INDEX on
+// a worker, forking the independent products of each step so that idle
+// workers can steal them. A worker waiting for its forks only helps with
+// other forks, so no request ever runs nested under another. Workers call
+// the impl's fibonacci() concurrently, so it must be reentrant (gmp locks
+// its memo).
+
+// below this, fibonacci_submit() computes the result in the calling thread
+#ifndef FIB_POOL_INLINE_INDEX
+#   define FIB_POOL_INLINE_INDEX 4096
+#endif
+
+// above this, the doubling steps are split into parallel products
+#ifndef FIB_POOL_SPLIT_INDEX
+#   define FIB_POOL_SPLIT_INDEX (1ull << 18)
+#endif
+
+struct fib_request;
+typedef void (*fib_callback)(struct fib_request *request);
+
+struct fib_request {
+    uint64_t index;
+    struct number result;   // set before completion, owned by the caller
+    fib_callback callback;  // called once done (on a worker, or inline), may be NULL
+    int eventfd;            // if >= 0, incremented once done, after result is set
+    void *ctx;              // untouched, for the caller
+};
+
+// Starts nworkers threads, or one per online CPU if nworkers is 0.
+// Returns 0 on success, -1 if the pool is already running or cannot start.
+int fib_pool_start(unsigned nworkers);
+
+// Runs every queued request to completion, then joins the workers.
+void fib_pool_stop(void);
+
+// Queues request, which must stay valid until it completes.
+// Returns 0, or -1 if the pool is not running.
+int fibonacci_submit(struct fib_request *request);
+
+#endif//FIB_POOL_H
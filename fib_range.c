@@ -0,0 +1,246 @@
+#include "fib_range.h"
+
+#include <fcntl.h>
+#include <gmp.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __AVX512F__
+#   include <immintrin.h>
+#endif
+
+#define LIMB_BYTES sizeof(uint64_t)
+
+// upper bound on the limbs of F(n), from log2(phi) < 711/1024
+static size_t nlimb_estimate(uint64_t const n)
+{
+    return (size_t)(((__uint128_t)n * 711) >> 16) + 2;
+}
+
+#ifdef __AVX512F__
+// computes (*a) + (*b) into dst (which may alias either), returns the carry
+//
+// Eight limbs are added at once. A lane generates a carry if its sum
+// wrapped, and propagates one if its sum is all ones; adding the propagate
+// mask to the shifted generate mask ripples the carries across all eight
+// lanes in a single scalar addition.
+static unsigned add_n(
+        uint64_t *dst,
+        uint64_t const *a, uint64_t const *b, size_t const n)
+{
+    __m512i const ones = _mm512_set1_epi64(-1);
+    unsigned carry = 0;
+    for (size_t offset = 0; offset < n; offset += 8)
+    {
+        unsigned const lanes = n - offset < 8 ? n - offset : 8;
+        __mmask8 const live = (1u << lanes) - 1;
+
+        __m512i const va = _mm512_maskz_loadu_epi64(live, &a[offset]);
+        __m512i const vb = _mm512_maskz_loadu_epi64(live, &b[offset]);
+        __m512i sum = _mm512_add_epi64(va, vb);
+
+        unsigned const generate = _mm512_cmplt_epu64_mask(sum, va);
+        unsigned const propagate = _mm512_cmpeq_epi64_mask(sum, ones);
+        unsigned const ripple = ((generate << 1) | carry) + propagate;
+
+        // subtracting all ones adds one to the lanes receiving a carry
+        sum = _mm512_mask_sub_epi64(sum, (ripple ^ propagate) & live, sum, ones);
+        _mm512_mask_storeu_epi64(&dst[offset], live, sum);
+        carry = (ripple >> lanes) != 0;
+    }
+    return carry;
+}
+#else
+// computes (*a) + (*b) into dst (which may alias either), returns the carry
+static unsigned add_n(
+        uint64_t *dst,
+        uint64_t const *a, uint64_t const *b, size_t const n)
+{
+    unsigned carry = 0;
+    for (size_t offset = 0; offset < n; ++offset)
+    {
+        uint64_t add = b[offset];
+        carry = __builtin_add_overflow(add, carry, &add);
+        carry += __builtin_add_overflow(a[offset], add, &dst[offset]);
+    }
+    return carry;
+}
+#endif
+
+// exports x as little-endian limbs, returns the number of limbs (at least 1)
+static size_t export_limbs(uint64_t *limbs, mpz_t const x)
+{
+    size_t count;
+    mpz_export(limbs, &count, -1, LIMB_BYTES, 0, 0, x);
+    return count ? count : 1;
+}
+
+// limbs of (F(first), F(first + 1)) into cur and next, zeroed up to capacity
+static void seed(uint64_t *cur, size_t *cur_len, uint64_t *next, size_t *next_len, uint64_t first)
+{
+    mpz_t fnext, fcur;
+    mpz_inits(fnext, fcur, NULL);
+    mpz_fib2_ui(fnext, fcur, first + 1);
+    *cur_len = export_limbs(cur, fcur);
+    *next_len = export_limbs(next, fnext);
+    mpz_clears(fnext, fcur, NULL);
+}
+
+int fib_iter_init(struct fib_iter *it, uint64_t first, uint64_t last)
+{
+    it->index = first;
+    it->capacity = nlimb_estimate(last + 1) + 1;
+    it->cur = calloc(2 * it->capacity, LIMB_BYTES);
+    if (!it->cur)
+    {
+        return -1;
+    }
+    it->next = &it->cur[it->capacity];
+    seed(it->cur, &it->cur_len, it->next, &it->next_len, first);
+    return 0;
+}
+
+void fib_iter_free(struct fib_iter *it)
+{
+    free(it->cur < it->next ? it->cur : it->next);
+    it->cur = it->next = NULL;
+}
+
+struct number fib_iter_value(struct fib_iter const *it)
+{
+    return (struct number){ it->cur, it->cur_len * LIMB_BYTES };
+}
+
+void fib_iter_next(struct fib_iter *it)
+{
+    // (cur, next) <- (next, cur + next), summed in place over cur;
+    // cur is zero past cur_len, so both operands span next_len limbs
+    unsigned const carry = add_n(it->cur, it->cur, it->next, it->next_len);
+    it->cur[it->next_len] = carry;
+
+    uint64_t *tmp = it->cur;
+    it->cur = it->next;
+    it->next = tmp;
+    it->cur_len = it->next_len;
+    it->next_len += carry;
+    ++it->index;
+}
+
+int fib_range(uint64_t first, uint64_t last, fib_range_callback callback, void *ctx)
+{
+    struct fib_iter it;
+    if (fib_iter_init(&it, first, last))
+    {
+        return -1;
+    }
+
+    int status = 0;
+    for (;;)
+    {
+        status = callback(it.index, fib_iter_value(&it), ctx);
+        if (status || it.index == last)
+        {
+            break;
+        }
+        fib_iter_next(&it);
+    }
+
+    fib_iter_free(&it);
+    return status;
+}
+
+struct record {
+    uint64_t index;
+    uint64_t length;
+    uint64_t limbs[];
+};
+
+int fib_range_to_file(uint64_t first, uint64_t last, char const *path)
+{
+    // size the (sparse) file for the worst case, trim it once done
+    __uint128_t const count = last - first + 1;
+    __uint128_t const index_sum = ((__uint128_t)first + last) * count / 2;
+    __uint128_t const bound
+        = count * (sizeof(struct record) + 2 * LIMB_BYTES)
+        + ((index_sum * 711) >> 16) * LIMB_BYTES
+        + LIMB_BYTES;
+    if (bound > (size_t)-1 >> 1)
+    {
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)bound))
+    {
+        close(fd);
+        return -1;
+    }
+    uint8_t *map = mmap(NULL, (size_t)bound, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    madvise(map, (size_t)bound, MADV_SEQUENTIAL);
+
+    // the first two records come from the seed, which may write up to
+    // F(first + 1)'s limb count into the first record's payload
+    struct record *prev = (struct record *)map;
+    size_t prev_len, cur_len;
+    uint64_t *seed_next = malloc((nlimb_estimate(first + 1) + 1) * LIMB_BYTES);
+    if (!seed_next)
+    {
+        munmap(map, (size_t)bound);
+        close(fd);
+        return -1;
+    }
+    seed(prev->limbs, &prev_len, seed_next, &cur_len, first);
+    prev->index = first;
+    prev->length = prev_len * LIMB_BYTES;
+
+    size_t used = sizeof(struct record) + prev->length;
+    if (first < last)
+    {
+        struct record *cur = (struct record *)&map[used];
+        memcpy(cur->limbs, seed_next, cur_len * LIMB_BYTES);
+        cur->index = first + 1;
+        cur->length = cur_len * LIMB_BYTES;
+        used += sizeof(struct record) + cur->length;
+
+        for (uint64_t index = first + 2; index <= last; ++index)
+        {
+            struct record *next = (struct record *)&map[used];
+
+            // F(index - 2) has at most one limb fewer than F(index - 1)
+            unsigned carry = add_n(next->limbs, prev->limbs, cur->limbs, prev_len);
+            size_t next_len = prev_len;
+            for (; next_len < cur_len; ++next_len)
+            {
+                carry = __builtin_add_overflow(cur->limbs[next_len], carry, &next->limbs[next_len]);
+            }
+            if (carry)
+            {
+                next->limbs[next_len++] = carry;
+            }
+
+            next->index = index;
+            next->length = next_len * LIMB_BYTES;
+            used += sizeof(struct record) + next->length;
+
+            prev = cur;
+            prev_len = cur_len;
+            cur = next;
+            cur_len = next_len;
+        }
+    }
+    free(seed_next);
+
+    int status = munmap(map, (size_t)bound);
+    status |= ftruncate(fd, (off_t)used);
+    status |= close(fd);
+    return status ? -1 : 0;
+}
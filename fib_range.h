@@ -0,0 +1,42 @@
+#ifndef FIB_RANGE_H
+#define FIB_RANGE_H
+
+#include "fib_base.h"
+
+// Streams F(first), F(first + 1), ... without restarting from scratch.
+// The iterator is seeded with a single fast-doubling evaluation of
+// (F(first), F(first + 1)) and then only ever adds the pair in place,
+// the same (cur, next) stepping as impl/linear.c.
+struct fib_iter {
+    uint64_t index;     // index of the current value
+    uint64_t *cur;      // F(index), little-endian 64-bit limbs
+    uint64_t *next;     // F(index + 1)
+    size_t cur_len;     // limbs in use
+    size_t next_len;
+    size_t capacity;    // limbs allocated per buffer
+};
+
+// Prepares it to yield F(first) up to F(last).
+// Returns 0 on success, -1 if the buffers cannot be allocated.
+int fib_iter_init(struct fib_iter *it, uint64_t first, uint64_t last);
+void fib_iter_free(struct fib_iter *it);
+
+// Read-only view of F(it->index); valid until the next fib_iter_next().
+struct number fib_iter_value(struct fib_iter const *it);
+void fib_iter_next(struct fib_iter *it);
+
+// Called once per index in order; a nonzero return stops the range early.
+typedef int (*fib_range_callback)(uint64_t index, struct number value, void *ctx);
+
+// Calls callback for F(first)..F(last) with views into one reusable buffer.
+// Returns 0, -1 on allocation failure, or the callback's nonzero result.
+int fib_range(uint64_t first, uint64_t last, fib_range_callback callback, void *ctx);
+
+// Writes F(first)..F(last) to path as consecutive records of
+//   uint64_t index; uint64_t length; uint8_t bytes[length];
+// with length a multiple of 8. Each value is summed directly from the two
+// previous records in the mapped file, so nothing is copied.
+// Returns 0 on success, -1 on I/O failure.
+int fib_range_to_file(uint64_t first, uint64_t last, char const *path);
+
+#endif//FIB_RANGE_H
@@ -0,0 +1,80 @@
+#include <gmp.h>
+#include "fib_registry.h"
+
+#ifndef FIB_REGISTRY
+#   error "compile with -DFIB_REGISTRY(X)=X(impl) X(impl) ..."
+#endif
+
+#define DECLARE(name) struct number fib_impl_##name(uint64_t index);
+FIB_REGISTRY(DECLARE)
+#undef DECLARE
+
+static struct number mpz_fib_ui_number(uint64_t index)
+{
+    mpz_t f;
+    mpz_init(f);
+    mpz_fib_ui(f, index);
+
+    size_t const length = (mpz_sizeinbase(f, 2) + CHAR_BIT - 1) / CHAR_BIT;
+    struct number n = { calloc(length ? length : 1, 1), length ? length : 1 };
+    mpz_export(n.bytes, NULL, -1, 1, 0, 0, f);
+    mpz_clear(f);
+    return n;
+}
+
+#define ENTRY(name) { #name, fib_impl_##name },
+struct fib_impl const fib_registry[] = {
+    { "mpz_fib_ui", mpz_fib_ui_number },
+    FIB_REGISTRY(ENTRY)
+};
+#undef ENTRY
+
+size_t const fib_registry_size = sizeof(fib_registry) / sizeof(fib_registry[0]);
+
+struct fib_impl const *fib_registry_find(char const *name)
+{
+    for (size_t i = 0; i < fib_registry_size; ++i)
+    {
+        if (!strcmp(fib_registry[i].name, name))
+        {
+            return &fib_registry[i];
+        }
+    }
+    return NULL;
+}
+
+unsigned fib_registry_select(char *names, struct fib_impl const **impls, unsigned max)
+{
+    unsigned n = 0;
+    if (!names)
+    {
+        for (; n < fib_registry_size; ++n)
+        {
+            if (n == max)
+            {
+                return 0;
+            }
+            impls[n] = &fib_registry[n];
+        }
+        return n;
+    }
+
+    for (char *name = strtok(names, ","); name; name = strtok(NULL, ","))
+    {
+        if (n == max || !(impls[n] = fib_registry_find(name)))
+        {
+            fprintf(stderr, "Unknown implementation: %s\n", name);
+            return 0;
+        }
+        ++n;
+    }
+    return n;
+}
+
+void fib_registry_list(FILE *out)
+{
+    for (size_t i = 0; i < fib_registry_size; ++i)
+    {
+        fprintf(out, "%s%s", i ? " " : "", fib_registry[i].name);
+    }
+}
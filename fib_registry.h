@@ -0,0 +1,34 @@
+#ifndef FIB_REGISTRY_H
+#define FIB_REGISTRY_H
+
+#include "fib_base.h"
+
+#include <stdio.h>
+
+// Every impl in one program.
+//
+// The Makefile compiles each impl a second time with fibonacci renamed to
+// fib_impl_<name> (obj/<name>.reg.o), and fib_registry.c with the list of
+// names in FIB_REGISTRY. Drivers linking both find the impls here by name,
+// along with an mpz_fib_ui() baseline, first in the table as "mpz_fib_ui".
+
+struct fib_impl {
+    char const *name;
+    struct number (*fibonacci)(uint64_t index);
+};
+
+extern struct fib_impl const fib_registry[];
+extern size_t const fib_registry_size;
+
+// NULL if there is no impl of that name
+struct fib_impl const *fib_registry_find(char const *name);
+
+// Fills impls[] from a comma-separated list of names (modified in place),
+// or with the whole registry for NULL. Returns how many, or 0 if a name is
+// unknown or there are more than max.
+unsigned fib_registry_select(char *names, struct fib_impl const **impls, unsigned max);
+
+// Prints the registered names to out, space-separated.
+void fib_registry_list(FILE *out);
+
+#endif//FIB_REGISTRY_H
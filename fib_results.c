@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+#include "fib_results.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// the Makefile passes the flags everything was built with, and the commit
+#ifndef FIB_CFLAGS
+#   define FIB_CFLAGS "unknown"
+#endif
+#ifndef FIB_COMMIT
+#   define FIB_COMMIT "unknown"
+#endif
+
+#if defined(__clang__)
+#   define FIB_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#   define FIB_COMPILER "gcc " __VERSION__
+#else
+#   define FIB_COMPILER "unknown"
+#endif
+
+void fib_results_string(FILE *out, char const *s)
+{
+    putc('"', out);
+    for (; *s; ++s)
+    {
+        unsigned char const c = *s;
+        if (c == '"' || c == '\\')
+        {
+            fprintf(out, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            putc(c, out);
+        }
+    }
+    putc('"', out);
+}
+
+static int cpu_model(char *model, size_t size)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f)
+    {
+        return -1;
+    }
+    char line[512];
+    int found = -1;
+    while (found && fgets(line, sizeof(line), f))
+    {
+        char const *value = strchr(line, ':');
+        if (value && !strncmp(line, "model name", strlen("model name")))
+        {
+            value += strspn(value + 1, " \t") + 1;
+            snprintf(model, size, "%.*s", (int)strcspn(value, "\n"), value);
+            found = 0;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+void fib_results_meta(FILE *out, char const *tool)
+{
+    char model[256] = "unknown";
+    cpu_model(model, sizeof(model));
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+
+    char const *commit = getenv("FIB_COMMIT");
+    if (!commit)
+    {
+        commit = FIB_COMMIT;
+    }
+
+    char date[32];
+    time_t const t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+    fputs("{\"type\":\"meta\",\"tool\":", out);
+    fib_results_string(out, tool);
+    fputs(",\"compiler\":", out);
+    fib_results_string(out, FIB_COMPILER);
+    fputs(",\"cflags\":", out);
+    fib_results_string(out, FIB_CFLAGS);
+    fputs(",\"cpu\":", out);
+    fib_results_string(out, model);
+    fprintf(out, ",\"cpus\":%ld,\"host\":", sysconf(_SC_NPROCESSORS_ONLN));
+    fib_results_string(out, host);
+    fputs(",\"commit\":", out);
+    fib_results_string(out, commit);
+    fputs(",\"date\":", out);
+    fib_results_string(out, date);
+}
@@ -0,0 +1,24 @@
+#ifndef FIB_RESULTS_H
+#define FIB_RESULTS_H
+
+#include <stdio.h>
+
+// Benchmark results as JSON lines, for compare.py (eval -J, bench -J).
+//
+// A results file is one JSON object per line. The first is the metadata of
+// the run, {"type":"meta", ...}: the tool, the compiler and the flags it
+// was built with, the CPU model and count, the host, the commit it was
+// built from (`git describe --always --dirty` at build time, $FIB_COMMIT
+// overriding it) and the UTC date, followed by the tool's own settings. Then
+// one {"type":"result", "impl":..., "index":..., "time_s":..., ...} per
+// impl and index, with "samples_s":[...], every timed run, when there were
+// repetitions. Times are in seconds, sizes in bytes, no units attached.
+
+// Writes the metadata object of a run of tool, without the closing brace:
+// the tool appends its own fields (`,"reps":7`) and ends it with "}\n".
+void fib_results_meta(FILE *out, char const *tool);
+
+// Writes s as a quoted and escaped JSON string.
+void fib_results_string(FILE *out, char const *s);
+
+#endif//FIB_RESULTS_H
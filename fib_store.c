@@ -0,0 +1,141 @@
+#include "fib_store.h"
+#include "fib_checksum.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int fib_store_open(struct fib_store *store, char const *path)
+{
+    memset(store, 0, sizeof(*store));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct fib_store_header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    struct fib_store_header const *header = map;
+    size_t const table_end = sizeof(*header) + header->count * sizeof(struct fib_store_entry);
+    if (memcmp(header->magic, FIB_STORE_MAGIC, sizeof(header->magic))
+            || header->version != FIB_STORE_VERSION
+            || header->byte_order != FIB_STORE_BYTE_ORDER
+            || header->file_size != (uint64_t)st.st_size
+            || header->count > FIB_STORE_MAX_K
+            || table_end > (size_t)st.st_size)
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    struct fib_store_entry const *entries = (void const *)&header[1];
+    for (unsigned k = 0; k < header->count; ++k)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (entries[k].offset[i] % FIB_STORE_ALIGN
+                    || entries[k].offset[i] + entries[k].length[i] > (uint64_t)st.st_size)
+            {
+                munmap(map, st.st_size);
+                return -1;
+            }
+        }
+    }
+
+    store->map = map;
+    store->size = st.st_size;
+    store->header = header;
+    store->entries = entries;
+    return 0;
+}
+
+void fib_store_close(struct fib_store *store)
+{
+    if (store->map)
+    {
+        munmap((void *)store->map, store->size);
+    }
+    memset(store, 0, sizeof(*store));
+}
+
+int fib_store_check(struct fib_store const *store)
+{
+    for (unsigned k = 0; k < store->header->count; ++k)
+    {
+        struct fib_store_entry const *entry = &store->entries[k];
+        uint64_t const begin = entry->offset[0];
+        uint64_t const end = entry->offset[2] + entry->length[2];
+        if (fib_checksum((uint8_t const *)store->map + begin, end - begin) != entry->checksum)
+        {
+            return (int)k;
+        }
+    }
+    return -1;
+}
+
+struct number fib_store_value(struct fib_store const *store, unsigned k, int offset)
+{
+    struct fib_store_entry const *entry = &store->entries[k];
+    return (struct number){
+        .bytes = (uint8_t *)store->map + entry->offset[offset + 1],
+        .length = entry->length[offset + 1],
+    };
+}
+
+int fib_store_prefix(struct fib_store const *store, uint64_t index)
+{
+    if (!store || !index || !store->header->count)
+    {
+        return -1;
+    }
+
+    uint64_t const rest = index & ~(1ull << (63 - __builtin_clzll(index)));
+    int k = rest
+        ? __builtin_clzll(rest) - __builtin_clzll(index) - 1
+        : 63 - __builtin_clzll(index);
+    if (k >= (int)store->header->count)
+    {
+        k = store->header->count - 1;
+    }
+    return k;
+}
+
+static struct fib_store default_store;
+static int default_store_ok;
+static pthread_once_t default_store_once = PTHREAD_ONCE_INIT;
+
+static void default_store_init(void)
+{
+    char const *path = getenv(FIB_STORE_ENV);
+    if (path && *path)
+    {
+        default_store_ok = fib_store_open(&default_store, path) == 0;
+        if (!default_store_ok)
+        {
+            fprintf(stderr, "# Ignoring unusable checkpoint store: %s\n", path);
+        }
+    }
+}
+
+struct fib_store const *fib_store_default(void)
+{
+    pthread_once(&default_store_once, default_store_init);
+    return default_store_ok ? &default_store : NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef FIB_STORE_H
+#define FIB_STORE_H
+
+#include "fib_base.h"
+
+// On-disk store of precomputed F(2^k - 1), F(2^k), F(2^k + 1) for k < count.
+//
+// The file is mapped read-only and shared, so every process using the same
+// store shares the same page-cache pages. Values are little-endian byte
+// strings, each starting on a FIB_STORE_ALIGN boundary and zero-padded to a
+// multiple of 8 bytes, so they can be copied straight into limb arrays.
+//
+// Layout:
+//   struct fib_store_header
+//   struct fib_store_entry[count]
+//   payload
+
+#define FIB_STORE_MAGIC "FIBSTORE"
+#define FIB_STORE_VERSION 1
+#define FIB_STORE_BYTE_ORDER 0x0102030405060708ull
+#define FIB_STORE_ALIGN 64
+#define FIB_STORE_MAX_K 40
+
+// environment variable naming the store used by fib_store_default()
+#define FIB_STORE_ENV "FIB_STORE"
+
+struct fib_store_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t byte_order;
+    uint64_t file_size;
+};
+
+// value[0] = F(2^k - 1), value[1] = F(2^k), value[2] = F(2^k + 1)
+struct fib_store_entry {
+    uint64_t offset[3];
+    uint64_t length[3];
+    uint64_t checksum;
+    uint64_t reserved;
+};
+
+struct fib_store {
+    void const *map;
+    size_t size;
+    struct fib_store_header const *header;
+    struct fib_store_entry const *entries;
+};
+
+// Maps the store at path. Returns 0 on success, -1 if the file is missing,
+// truncated, from another version or written with another byte order.
+int fib_store_open(struct fib_store *store, char const *path);
+void fib_store_close(struct fib_store *store);
+
+// Recomputes every entry's checksum. Returns the first bad k, or -1.
+int fib_store_check(struct fib_store const *store);
+
+// Read-only view of F(2^k + offset) for offset in {-1, 0, 1}.
+struct number fib_store_value(struct fib_store const *store, unsigned k, int offset);
+
+// The doubling loops consume the index from the top bit down, so after
+// k + 1 bits the partial index is 2^k exactly when the top bit is followed
+// by k zeros. Returns the largest such k present in the store, or -1.
+int fib_store_prefix(struct fib_store const *store, uint64_t index);
+
+// Process-wide store named by $FIB_STORE, opened on first use.
+// NULL if the variable is unset or the file is unusable.
+struct fib_store const *fib_store_default(void);
+
+#endif//FIB_STORE_H
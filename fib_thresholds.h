@@ -0,0 +1,38 @@
+#ifndef FIB_THRESHOLDS_H
+#define FIB_THRESHOLDS_H
+
+// Per-machine crossovers.
+//
+// `make tune` measures the crossovers on the current host (tune.c) and
+// writes them to fib_tune.h, which is not versioned; every header with a
+// tunable threshold includes this one before setting its default, so the
+// measured values win and anything tune.c left out keeps the default.
+//
+// `make fit` writes fib_fit.h the same way, with the seeds of
+// fib_dispatch.h fitted from recorded results (fit.py).
+//
+// tune.c itself is built with FIB_TUNE_PROGRAM, which turns the thresholds
+// into variables it can move between measurements, as GMP's tuneup does.
+
+#ifdef FIB_TUNE_PROGRAM
+#   include <stddef.h>
+    extern size_t fib_tune_parallel_limbs;
+    extern size_t fib_tune_parallel_gmp_limbs;
+    extern size_t fib_tune_lockstep_max_index;
+    extern size_t fib_tune_decimal_leaf_digits;
+    extern size_t fib_tune_decimal_thread_digits;
+#   define FIB_PARALLEL_LIMBS fib_tune_parallel_limbs
+#   define FIB_PARALLEL_GMP_LIMBS fib_tune_parallel_gmp_limbs
+#   define FIB_LOCKSTEP_MAX_INDEX fib_tune_lockstep_max_index
+#   define FIB_DECIMAL_LEAF_DIGITS fib_tune_decimal_leaf_digits
+#   define FIB_DECIMAL_THREAD_DIGITS fib_tune_decimal_thread_digits
+#elif defined(__has_include)
+#   if __has_include("fib_tune.h")
+#       include "fib_tune.h"
+#   endif
+#   if __has_include("fib_fit.h")
+#       include "fib_fit.h"
+#   endif
+#endif
+
+#endif//FIB_THRESHOLDS_H
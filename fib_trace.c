@@ -0,0 +1,132 @@
+#include "fib_trace.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct span {
+    char const *phase;
+    uint64_t start;
+    uint64_t end;
+    int64_t iteration;
+    uint64_t size1;
+    uint64_t size2;
+};
+
+// one per thread that recorded something, never freed: the spans of a
+// thread that exited are still dumped
+struct ring {
+    struct ring *next;
+    unsigned tid;
+    uint64_t count;                 // spans ever recorded
+    struct span spans[FIB_TRACE_EVENTS];
+};
+
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ring *rings = NULL;
+static unsigned rings_count = 0;
+
+static _Thread_local struct ring *own = NULL;
+static _Thread_local int64_t current_iteration = -1;
+
+uint64_t fib_trace_clock(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+void fib_trace_iteration(int64_t iteration)
+{
+    current_iteration = iteration;
+}
+
+static struct ring *register_ring(void)
+{
+    struct ring *const ring = malloc(sizeof(*ring));
+    if (!ring)
+    {
+        return NULL;
+    }
+    ring->count = 0;
+    pthread_mutex_lock(&rings_lock);
+    ring->tid = ++rings_count;
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&rings_lock);
+    return ring;
+}
+
+void fib_trace_record(char const *phase, uint64_t start, uint64_t size1, uint64_t size2)
+{
+    uint64_t const end = fib_trace_clock();
+    if (!own && !(own = register_ring()))
+    {
+        return;
+    }
+    own->spans[own->count++ % FIB_TRACE_EVENTS] = (struct span){
+        phase, start, end, current_iteration, size1, size2,
+    };
+}
+
+// timestamps in µs, as the format wants, relative to the earliest span
+static void dump_span(FILE *out, struct span const *s, unsigned tid, uint64_t origin, int *first)
+{
+    fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+        "\"args\":{",
+        *first ? "" : ",", s->phase, tid, (s->start - origin) / 1e3, (s->end - s->start) / 1e3);
+    if (s->iteration >= 0)
+    {
+        fprintf(out, "\"iteration\":%" PRId64 ",", s->iteration);
+    }
+    fprintf(out, "\"size1\":%" PRIu64 ",\"size2\":%" PRIu64 "}}", s->size1, s->size2);
+    *first = 0;
+}
+
+int fib_trace_dump(FILE *out)
+{
+    pthread_mutex_lock(&rings_lock);
+
+    uint64_t origin = UINT64_MAX;
+    for (struct ring const *ring = rings; ring; ring = ring->next)
+    {
+        uint64_t const kept = ring->count < FIB_TRACE_EVENTS ? ring->count : FIB_TRACE_EVENTS;
+        for (uint64_t i = ring->count - kept; i < ring->count; ++i)
+        {
+            struct span const *s = &ring->spans[i % FIB_TRACE_EVENTS];
+            origin = s->start < origin ? s->start : origin;
+        }
+    }
+
+    int first = 1;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    for (struct ring const *ring = rings; ring; ring = ring->next)
+    {
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"thread %u%s\"}}",
+            first ? "" : ",", ring->tid, ring->tid, ring->count > FIB_TRACE_EVENTS ? " (truncated)" : "");
+        first = 0;
+
+        // oldest first
+        uint64_t const kept = ring->count < FIB_TRACE_EVENTS ? ring->count : FIB_TRACE_EVENTS;
+        for (uint64_t i = ring->count - kept; i < ring->count; ++i)
+        {
+            dump_span(out, &ring->spans[i % FIB_TRACE_EVENTS], ring->tid, origin, &first);
+        }
+    }
+    fputs("\n]}\n", out);
+
+    pthread_mutex_unlock(&rings_lock);
+    return ferror(out) ? -1 : 0;
+}
+
+void fib_trace_reset(void)
+{
+    pthread_mutex_lock(&rings_lock);
+    for (struct ring *ring = rings; ring; ring = ring->next)
+    {
+        ring->count = 0;
+    }
+    pthread_mutex_unlock(&rings_lock);
+}
@@ -0,0 +1,50 @@
+#ifndef FIB_TRACE_H
+#define FIB_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Phase spans inside fibonacci() calls, for builds with -DTRACE.
+//
+// The doubling impls mark their phases (memset, squarings, cross products,
+// additions, length scans) with trace_begin(span) ... trace_end(span,
+// phase, size1, size2): the span is stamped with the iteration last given
+// to trace_iteration() on that thread (work handed to a helper carries its
+// iteration and sets it there) and the operand sizes in limbs. Each thread
+// records into a ring of its own, FIB_TRACE_EVENTS spans long (the oldest are
+// overwritten), so recording takes no lock and costs two clock reads.
+//
+// fib_trace_dump() writes the spans of every thread as Chrome trace JSON,
+// for chrome://tracing or ui.perfetto.dev; it must not race with traced
+// calls. Without TRACE the macros are empty and the impls are unchanged.
+
+#ifndef FIB_TRACE_EVENTS
+#   define FIB_TRACE_EVENTS 65536
+#endif
+
+#ifdef TRACE
+#   define trace_iteration(i) fib_trace_iteration(i)
+#   define trace_begin(span) uint64_t const span = fib_trace_clock()
+#   define trace_end(span, phase, size1, size2) fib_trace_record(phase, span, size1, size2)
+#else
+#   define trace_iteration(i)
+#   define trace_begin(span)
+#   define trace_end(...)
+#endif
+
+// CLOCK_MONOTONIC, in ns
+uint64_t fib_trace_clock(void);
+
+// Iteration the spans of the calling thread are stamped with from now on.
+void fib_trace_iteration(int64_t iteration);
+
+// Records [start, now) as phase (a string with static storage).
+void fib_trace_record(char const *phase, uint64_t start, uint64_t size1, uint64_t size2);
+
+// Writes the recorded spans as a Chrome trace; returns nonzero on error.
+int fib_trace_dump(FILE *out);
+
+// Forgets the recorded spans.
+void fib_trace_reset(void);
+
+#endif//FIB_TRACE_H
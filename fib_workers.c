@@ -0,0 +1,159 @@
+#define _GNU_SOURCE
+#include "fib_workers.h"
+#include "fib_control.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define SPIN_ROUNDS (1 << 16)
+
+struct helper {
+    pthread_t thread;
+    atomic_ulong seq;       // bumped by the caller for every new job
+    atomic_ulong done;      // set to seq by the helper once the job is done
+    atomic_int parked;
+    struct fib_job job;
+    struct fib_control *control;    // the caller's, attached for the job
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} __attribute__((aligned(64)));
+
+static struct helper helpers[FIB_WORKERS_MAX];
+static unsigned nhelpers;
+static atomic_flag helpers_busy = ATOMIC_FLAG_INIT;
+static pthread_once_t helpers_once = PTHREAD_ONCE_INIT;
+
+static void *helper_main(void *arg)
+{
+    struct helper *h = arg;
+    unsigned long seen = 0;
+    for (;;)
+    {
+        // spin first, park only if nothing shows up for a while
+        unsigned spin = 0;
+        while (atomic_load(&h->seq) == seen && spin++ < SPIN_ROUNDS)
+        {
+            __builtin_ia32_pause();
+        }
+        if (atomic_load(&h->seq) == seen)
+        {
+            pthread_mutex_lock(&h->lock);
+            atomic_store(&h->parked, 1);
+            while (atomic_load(&h->seq) == seen)
+            {
+                pthread_cond_wait(&h->wake, &h->lock);
+            }
+            atomic_store(&h->parked, 0);
+            pthread_mutex_unlock(&h->lock);
+        }
+
+        seen = atomic_load(&h->seq);
+        fib_control_attach(h->control);
+        h->job.run(h->job.arg);
+        fib_control_attach(NULL);
+        atomic_store_explicit(&h->done, seen, memory_order_release);
+    }
+    return NULL;
+}
+
+static void helpers_init(void)
+{
+    long const ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned count = ncpu > 1 ? (unsigned)ncpu - 1 : 0;
+    char const *env = getenv("FIB_WORKERS");
+    if (env && *env)
+    {
+        count = strtoul(env, NULL, 10);
+    }
+    if (count > FIB_WORKERS_MAX)
+    {
+        count = FIB_WORKERS_MAX;
+    }
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        struct helper *h = &helpers[i];
+        pthread_mutex_init(&h->lock, NULL);
+        pthread_cond_init(&h->wake, NULL);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (ncpu > 1)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET((i + 1) % ncpu, &cpus);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        }
+        int const failed = pthread_create(&h->thread, &attr, helper_main, h);
+        pthread_attr_destroy(&attr);
+        if (failed)
+        {
+            break;
+        }
+        pthread_detach(h->thread);
+        ++nhelpers;
+    }
+}
+
+unsigned fib_workers_available(void)
+{
+    pthread_once(&helpers_once, helpers_init);
+    return nhelpers;
+}
+
+void fib_workers_run(struct fib_job const *jobs, unsigned njobs)
+{
+    // the helpers serve one caller at a time, any other runs serially
+    unsigned nhanded = njobs > 1 && fib_workers_available() ? njobs - 1 : 0;
+    if (nhanded && atomic_flag_test_and_set_explicit(&helpers_busy, memory_order_acquire))
+    {
+        nhanded = 0;
+    }
+    if (nhanded > nhelpers)
+    {
+        nhanded = nhelpers;
+    }
+
+    unsigned long seq[FIB_WORKERS_MAX];
+    for (unsigned i = 0; i < nhanded; ++i)
+    {
+        struct helper *h = &helpers[i];
+        h->job = jobs[i + 1];
+        h->control = fib_control_current;
+        seq[i] = atomic_fetch_add(&h->seq, 1) + 1;
+        if (atomic_load(&h->parked))
+        {
+            pthread_mutex_lock(&h->lock);
+            pthread_cond_signal(&h->wake);
+            pthread_mutex_unlock(&h->lock);
+        }
+    }
+
+    jobs[0].run(jobs[0].arg);
+    for (unsigned i = nhanded + 1; i < njobs; ++i)
+    {
+        jobs[i].run(jobs[i].arg);
+    }
+
+    for (unsigned i = 0; i < nhanded; ++i)
+    {
+        for (unsigned spin = 0; atomic_load_explicit(&helpers[i].done, memory_order_acquire) != seq[i]; ++spin)
+        {
+            if (spin < SPIN_ROUNDS)
+            {
+                __builtin_ia32_pause();
+            }
+            else
+            {
+                sched_yield();
+            }
+        }
+    }
+    if (nhanded)
+    {
+        atomic_flag_clear_explicit(&helpers_busy, memory_order_release);
+    }
+}
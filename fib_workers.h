@@ -0,0 +1,42 @@
+#ifndef FIB_WORKERS_H
+#define FIB_WORKERS_H
+
+#include "fib_base.h"
+#include "fib_thresholds.h"
+
+// Persistent helper threads for running the independent products of one
+// doubling step side by side.
+//
+// Helpers are started on first use, pinned one per CPU (skipping CPU 0),
+// and hand work over through a sequence counter: a helper spins on it for
+// a while after finishing a job and only then parks on a condition
+// variable, so back-to-back steps never pay for a thread wake-up.
+// There is one helper per spare CPU up to FIB_WORKERS_MAX; $FIB_WORKERS
+// overrides that count, and 0 turns the helpers off.
+
+// most helpers ever started; a doubling step has three products
+#define FIB_WORKERS_MAX 2
+
+// operand size (in 64-bit limbs) from which the impls go parallel
+#ifndef FIB_PARALLEL_LIMBS
+#   define FIB_PARALLEL_LIMBS 256
+#endif
+#ifndef FIB_PARALLEL_GMP_LIMBS
+#   define FIB_PARALLEL_GMP_LIMBS 2048
+#endif
+
+struct fib_job {
+    void (*run)(void *arg);
+    void *arg;
+};
+
+// Number of helpers available (starting them if needed), 0 if none.
+unsigned fib_workers_available(void);
+
+// Runs jobs[0] on the calling thread and the others on helpers, and returns
+// once all of them are done. Jobs without a helper run on the caller. A
+// helper attaches the caller's fib_control for the duration of its job, so
+// fib_cancelled() and fib_progress() in a job see the caller's.
+void fib_workers_run(struct fib_job const *jobs, unsigned njobs);
+
+#endif//FIB_WORKERS_H
@@ -0,0 +1,133 @@
+#include "fib_write.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#   include <immintrin.h>
+#endif
+
+static char const hex_digits[16] = "0123456789abcdef";
+
+// out[2i], out[2i+1] = hex of top[-1-i] for i < count
+static void encode(char *out, uint8_t const *top, size_t count)
+{
+#if defined(__AVX2__)
+    __m256i const reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i const digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((void const *)hex_digits));
+    __m256i const nibble = _mm256_set1_epi8(0x0f);
+    for (; count >= 32; count -= 32, top -= 32, out += 64)
+    {
+        // reverse within lanes, then swap the lanes
+        __m256i x = _mm256_loadu_si256((void const *)(top - 32));
+        x = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, reverse), 0x4e);
+
+        __m256i const hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+        __m256i const lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, nibble));
+
+        // unpack works per lane: a = bytes 0-7 | 16-23, b = bytes 8-15 | 24-31
+        __m256i const a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i const b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((void *)out, _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((void *)(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+#elif defined(__SSSE3__)
+    __m128i const reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m128i const digits = _mm_loadu_si128((void const *)hex_digits);
+    __m128i const nibble = _mm_set1_epi8(0x0f);
+    for (; count >= 16; count -= 16, top -= 16, out += 32)
+    {
+        __m128i const x = _mm_shuffle_epi8(_mm_loadu_si128((void const *)(top - 16)), reverse);
+        __m128i const hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+        __m128i const lo = _mm_shuffle_epi8(digits, _mm_and_si128(x, nibble));
+        _mm_storeu_si128((void *)out, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((void *)(out + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; count; --count, out += 2)
+    {
+        uint8_t const byte = *--top;
+        out[0] = hex_digits[byte >> 4];
+        out[1] = hex_digits[byte & 0x0f];
+    }
+}
+
+static int write_all(int fd, void const *buf, size_t len)
+{
+    uint8_t const *bytes = buf;
+    while (len)
+    {
+        ssize_t written = write(fd, bytes, len);
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        bytes += written;
+        len -= written;
+    }
+    return 0;
+}
+
+void fib_encode_hex(char *out, struct number n)
+{
+    encode(out, (uint8_t const *)n.bytes + n.length, n.length);
+}
+
+int fib_write_hex(int fd, struct number n, char const *suffix)
+{
+    size_t const chunk = FIB_WRITE_BUFFER / 2;
+    char *buffer = malloc(2 * chunk);
+    if (!buffer)
+    {
+        return -1;
+    }
+
+    uint8_t const *top = (uint8_t const *)n.bytes + n.length;
+    int status = 0;
+    for (size_t left = n.length; left && !status;)
+    {
+        size_t const count = left < chunk ? left : chunk;
+        encode(buffer, top, count);
+        status = write_all(fd, buffer, 2 * count);
+        top -= count;
+        left -= count;
+    }
+    free(buffer);
+
+    if (!status && suffix)
+    {
+        status = write_all(fd, suffix, strlen(suffix));
+    }
+    return status;
+}
+
+int fib_write_hex_mapped(int fd, struct number n)
+{
+    size_t const size = fib_hex_length(n);
+    if (ftruncate(fd, size))
+    {
+        return -1;
+    }
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    // populated up front, rather than faulted in page by page while encoding
+    char *map = mmap(NULL, size, PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+    fib_encode_hex(map, n);
+    return munmap(map, size);
+}
+
+int fib_write_raw(int fd, struct number n)
+{
+    return write_all(fd, n.bytes, n.length);
+}
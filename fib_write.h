@@ -0,0 +1,39 @@
+#ifndef FIB_WRITE_H
+#define FIB_WRITE_H
+
+#include "fib_base.h"
+
+// Bulk output of results.
+//
+// Hex output is two lowercase digits per byte, most significant byte first
+// and leading zero bytes included, as hex.c always printed it. Digits are
+// encoded 32 or 16 bytes at a time (AVX2, or SSSE3) into FIB_WRITE_BUFFER
+// sized chunks that go out with one write() each, or straight into a
+// mapped file. Raw output is the little-endian bytes as they are.
+//
+// All functions return 0 on success and -1 on failure (errno is set).
+
+#ifndef FIB_WRITE_BUFFER
+#   define FIB_WRITE_BUFFER (1 << 20)
+#endif
+
+// Number of characters fib_encode_hex() produces for n.
+static inline size_t fib_hex_length(struct number n)
+{
+    return 2 * n.length;
+}
+
+// Encodes n into out[0, fib_hex_length(n)), without a terminator.
+void fib_encode_hex(char *out, struct number n);
+
+// Writes n in hex to fd, followed by suffix (may be NULL).
+int fib_write_hex(int fd, struct number n, char const *suffix);
+
+// Sizes the regular file behind fd (opened read-write) to the hex output
+// and encodes n straight into its mapping.
+int fib_write_hex_mapped(int fd, struct number n);
+
+// Writes the bytes of n to fd as they are.
+int fib_write_raw(int fd, struct number n);
+
+#endif//FIB_WRITE_H
@@ -0,0 +1,386 @@
+#define _GNU_SOURCE
+#include "fib_base.h"
+#include "fibd.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// requests gathered from all ready clients before one fibonacci_many() call
+#ifndef FIBD_BATCH_MAX
+#   define FIBD_BATCH_MAX 1024
+#endif
+
+// direct-mapped result cache; larger results are not kept
+#ifndef FIBD_CACHE_SLOTS
+#   define FIBD_CACHE_SLOTS 4096
+#endif
+#ifndef FIBD_CACHE_MAX_BYTES
+#   define FIBD_CACHE_MAX_BYTES (1 << 16)
+#endif
+
+// computed once at startup to initialize GMP and fault in the heap
+#ifndef FIBD_WARMUP_INDEX
+#   define FIBD_WARMUP_INDEX 1000000
+#endif
+
+// largest index served, so that one client cannot make the daemon allocate
+// and compute without bound for everyone (F(10^8) is about 8.7 MB)
+#ifndef FIBD_MAX_INDEX
+#   define FIBD_MAX_INDEX 100000000
+#endif
+
+// replies queued for a client past which its requests are left in the
+// socket until it reads some, and past which it is dropped
+#ifndef FIBD_QUEUE_BYTES
+#   define FIBD_QUEUE_BYTES (64 << 20)
+#endif
+#ifndef FIBD_QUEUE_MAX_BYTES
+#   define FIBD_QUEUE_MAX_BYTES (1ull << 30)
+#endif
+
+#define MAX_EVENTS 64
+
+// bytes [start, end) of data are still to be sent
+struct buffer {
+    uint8_t *data;
+    size_t start;
+    size_t end;
+    size_t capacity;
+};
+
+struct client {
+    int fd;
+    uint8_t partial[sizeof(uint64_t)];  // a request split across reads
+    unsigned npartial;
+    int closing;        // no more requests, close once the replies are out
+    int touched;        // already listed for the flush after this batch
+    uint32_t events;    // registered with epoll
+    struct buffer out;
+    size_t promised;    // bound on the replies to the requests not answered yet
+};
+
+struct pending {
+    struct client *client;
+    uint64_t index;
+    struct number const *value;
+};
+
+static struct {
+    uint64_t index;
+    struct number value;    // bytes is NULL for an empty slot
+} cache[FIBD_CACHE_SLOTS];
+
+static volatile sig_atomic_t stopping;
+
+static uint64_t max_index = FIBD_MAX_INDEX;
+
+// the value of every refused request
+static struct number const refused = { NULL, 0 };
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+// bound on the bytes of the reply to index: F(n) has n log2(phi) bits
+static size_t reply_bound(uint64_t index)
+{
+    return sizeof(struct fibd_reply) + (index > max_index ? 0 : (size_t)(index * 0.0868) + 8);
+}
+
+// replies to c, queued or still to come
+static size_t queued(struct client const *c)
+{
+    return c->out.end - c->out.start + c->promised;
+}
+
+static void buffer_append(struct buffer *b, void const *data, size_t length)
+{
+    if (b->end + length > b->capacity)
+    {
+        // slide the unsent bytes down, then grow if that is not enough
+        memmove(b->data, b->data + b->start, b->end - b->start);
+        b->end -= b->start;
+        b->start = 0;
+        if (b->end + length > b->capacity)
+        {
+            b->capacity = 2 * b->capacity > b->end + length ? 2 * b->capacity : b->end + length;
+            b->data = realloc(b->data, b->capacity);
+        }
+    }
+    memcpy(b->data + b->end, data, length);
+    b->end += length;
+}
+
+// sends as much as the socket takes; returns -1 if the client is gone
+static int flush(struct client *c)
+{
+    while (c->out.start < c->out.end)
+    {
+        ssize_t const sent = send(c->fd, c->out.data + c->out.start,
+            c->out.end - c->out.start, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        c->out.start += sent;
+    }
+    // keep the buffer itself, it is reused for the next replies
+    c->out.start = c->out.end = 0;
+    return 0;
+}
+
+// reads whole requests into batch[*count, FIBD_BATCH_MAX), no more than
+// could be answered within FIBD_QUEUE_BYTES (but at least one); anything
+// beyond stays in the socket for a later round
+static void receive(struct client *c, struct pending *batch, size_t *count)
+{
+    uint8_t buf[FIBD_BATCH_MAX * sizeof(uint64_t)];
+    size_t const worst = reply_bound(max_index);
+    while (!c->closing && *count < FIBD_BATCH_MAX && queued(c) < FIBD_QUEUE_BYTES)
+    {
+        size_t const fit = (FIBD_QUEUE_BYTES - queued(c)) / worst + 1;
+        size_t const take = fit < FIBD_BATCH_MAX - *count ? fit : FIBD_BATCH_MAX - *count;
+        size_t const room = take * sizeof(uint64_t) - c->npartial;
+        memcpy(buf, c->partial, c->npartial);
+        ssize_t const got = recv(c->fd, buf + c->npartial, room, 0);
+        if (got <= 0)
+        {
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            {
+                c->closing = 1;
+            }
+            return;
+        }
+
+        size_t const total = c->npartial + got;
+        size_t offset = 0;
+        for (; offset + sizeof(uint64_t) <= total; offset += sizeof(uint64_t))
+        {
+            batch[*count].client = c;
+            memcpy(&batch[*count].index, buf + offset, sizeof(uint64_t));
+            c->promised += reply_bound(batch[*count].index);
+            ++*count;
+        }
+        c->npartial = total - offset;
+        memcpy(c->partial, buf + offset, c->npartial);
+    }
+}
+
+static struct number trimmed(struct number n)
+{
+    uint8_t const *bytes = n.bytes;
+    while (n.length && !bytes[n.length - 1])
+    {
+        --n.length;
+    }
+    return n;
+}
+
+// answers every request of the batch, in order, from the cache or from a
+// single fibonacci_many() over the misses
+static void answer(struct pending *batch, size_t count,
+        uint64_t *misses, struct number *computed)
+{
+    size_t nmisses = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t const slot = batch[i].index % FIBD_CACHE_SLOTS;
+        if (batch[i].index > max_index)
+        {
+            batch[i].value = &refused;
+        }
+        else if (cache[slot].value.bytes && cache[slot].index == batch[i].index)
+        {
+            batch[i].value = &cache[slot].value;
+        }
+        else
+        {
+            batch[i].value = NULL;
+            misses[nmisses++] = batch[i].index;
+        }
+    }
+
+    fibonacci_many(misses, nmisses, computed);
+    for (size_t i = 0, j = 0; i < count; ++i)
+    {
+        if (!batch[i].value)
+        {
+            computed[j] = trimmed(computed[j]);
+            batch[i].value = &computed[j++];
+        }
+        batch[i].client->promised -= reply_bound(batch[i].index);
+        if (batch[i].value == &refused)
+        {
+            struct fibd_reply const reply = { batch[i].index, FIBD_REFUSED };
+            buffer_append(&batch[i].client->out, &reply, sizeof(reply));
+            continue;
+        }
+
+        struct fibd_reply const reply = { batch[i].index, batch[i].value->length };
+        buffer_append(&batch[i].client->out, &reply, sizeof(reply));
+        buffer_append(&batch[i].client->out, batch[i].value->bytes, reply.length);
+    }
+
+    // the cache changes only once every reply is copied out of it
+    for (size_t j = 0; j < nmisses; ++j)
+    {
+        size_t const slot = misses[j] % FIBD_CACHE_SLOTS;
+        if (computed[j].length <= FIBD_CACHE_MAX_BYTES
+            && !(cache[slot].value.bytes && cache[slot].index == misses[j]))
+        {
+            free(cache[slot].value.bytes);
+            cache[slot].index = misses[j];
+            cache[slot].value = computed[j];
+        }
+        else
+        {
+            free(computed[j].bytes);
+        }
+    }
+}
+
+static void drop(int epfd, struct client *c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->out.data);
+    free(c);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm': max_index = strtoull(optarg, NULL, 0); break;
+            default: optind = argc + 1; break;
+        }
+    }
+
+    char const *path = optind < argc ? argv[optind] : FIBD_SOCKET;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (optind + 1 < argc || strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Usage: %s [-m max_index] [socket]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+
+    // results come and go in sizes well above the default mmap threshold;
+    // keep them on the heap and the heap from shrinking, so that pages
+    // stay faulted in from one batch to the next
+    mallopt(M_MMAP_THRESHOLD, 1 << 30);
+    mallopt(M_TRIM_THRESHOLD, 1 << 30);
+    free(fibonacci(FIBD_WARMUP_INDEX).bytes);
+
+    int const listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listener < 0
+        || bind(listener, (struct sockaddr *)&addr, sizeof(addr))
+        || listen(listener, SOMAXCONN))
+    {
+        fprintf(stderr, "Failed to listen on %s.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action = { .sa_handler = on_signal };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int const epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &event);
+
+    struct pending *batch = malloc(FIBD_BATCH_MAX * sizeof(*batch));
+    uint64_t *misses = malloc(FIBD_BATCH_MAX * sizeof(*misses));
+    struct number *computed = malloc(FIBD_BATCH_MAX * sizeof(*computed));
+    struct client **touched = malloc(MAX_EVENTS * sizeof(*touched));
+    fprintf(stderr, "# Listening on %s\n", path);
+
+    while (!stopping)
+    {
+        struct epoll_event events[MAX_EVENTS];
+        int const nevents = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (nevents < 0)
+        {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+
+        // gather requests from every ready client, then answer them together
+        size_t count = 0, ntouched = 0;
+        for (int i = 0; i < nevents; ++i)
+        {
+            struct client *c = events[i].data.ptr;
+            if (!c)
+            {
+                int fd;
+                while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    c = calloc(1, sizeof(*c));
+                    c->fd = fd;
+                    c->events = EPOLLIN;
+                    struct epoll_event add = { .events = c->events, .data.ptr = c };
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &add);
+                }
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                receive(c, batch, &count);
+            }
+            if (!c->touched)
+            {
+                c->touched = 1;
+                touched[ntouched++] = c;
+            }
+        }
+
+        if (count)
+        {
+            answer(batch, count, misses, computed);
+        }
+
+        for (size_t i = 0; i < ntouched; ++i)
+        {
+            struct client *c = touched[i];
+            c->touched = 0;
+            if (flush(c) || (c->closing && c->out.start == c->out.end))
+            {
+                drop(epfd, c);
+                continue;
+            }
+            if (queued(c) > FIBD_QUEUE_MAX_BYTES)
+            {
+                fprintf(stderr, "# Dropped a client with %zu bytes of replies queued\n", queued(c));
+                drop(epfd, c);
+                continue;
+            }
+
+            // wait for room in the socket only while replies are queued, and
+            // for requests only while there is room for their replies
+            uint32_t const events = (c->closing || queued(c) >= FIBD_QUEUE_BYTES ? 0 : EPOLLIN)
+                | (c->out.start < c->out.end ? EPOLLOUT : 0);
+            if (events != c->events)
+            {
+                struct epoll_event mod = { .events = events, .data.ptr = c };
+                epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &mod);
+                c->events = events;
+            }
+        }
+    }
+
+    unlink(path);
+    return EXIT_SUCCESS;
+}
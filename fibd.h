@@ -0,0 +1,24 @@
+#ifndef FIBD_H
+#define FIBD_H
+
+#include <stdint.h>
+
+// Wire protocol of fibd, in host byte order since the socket is local.
+//
+// A request is a bare uint64_t index, and a client may pipeline as many as
+// it likes, though the daemon stops reading them while too many replies
+// wait for the client to take them (and drops a client far behind). Replies come back in request order on the same connection, each
+// as a struct fibd_reply followed by length bytes of F(index), little-endian
+// and without zero padding (so F(0) has length 0). An index above the
+// daemon's maximum (fibd -m) is refused: its reply has length FIBD_REFUSED
+// and no bytes follow.
+
+#define FIBD_SOCKET "/tmp/fibd.sock"
+#define FIBD_REFUSED UINT64_MAX
+
+struct fibd_reply {
+    uint64_t index;
+    uint64_t length;
+};
+
+#endif//FIBD_H
@@ -0,0 +1,63 @@
+#include <gmp.h>
+#include "fib_file.h"
+
+#include <stdio.h>
+
+// Prints the header of a .fib file and checks its payload; with -v, also
+// compares the value against mpz_fib_ui(), reading it in place.
+
+int main(int argc, char *argv[])
+{
+    int const verify = argc > 1 && !strcmp(argv[1], "-v");
+    if (argc != 2 + verify)
+    {
+        fprintf(stderr, "Usage: %s [-v] file.fib\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    char const *path = argv[1 + verify];
+
+    struct fib_file file;
+    if (fib_file_open(&file, path))
+    {
+        fprintf(stderr, "Failed to open %s as a .fib file.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct fib_file_header const *header = file.header;
+    printf(
+        "index:      %llu\n"
+        "length:     %llu B\n"
+        "limb size:  %u B\n"
+        "endianness: %s\n",
+        (long long unsigned)header->index,
+        (long long unsigned)header->length,
+        header->limb_size,
+        header->endianness == FIB_FILE_LITTLE ? "little" : "big"
+    );
+
+    int status = EXIT_SUCCESS;
+    if (fib_file_check(&file))
+    {
+        puts("checksum:   MISMATCH");
+        status = EXIT_FAILURE;
+    }
+    else
+    {
+        puts("checksum:   ok");
+    }
+
+    if (verify && status == EXIT_SUCCESS)
+    {
+        mpz_t view, expected;
+        mpz_srcptr value = fib_file_mpz(&file, view);
+        mpz_init(expected);
+        mpz_fib_ui(expected, header->index);
+        int const same = !mpz_cmp(value, expected);
+        printf("value:      %s\n", same ? "ok" : "WRONG");
+        status = same ? EXIT_SUCCESS : EXIT_FAILURE;
+        mpz_clear(expected);
+    }
+
+    fib_file_close(&file);
+    return status;
+}
@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+#include "fibd.h"
+
+#include <gmp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Load client for fibd: keeps depth requests in flight on each of several
+// connections, with indices drawn uniformly from [0, max_index], and reports
+// throughput and latency percentiles (optionally checking every reply).
+
+struct connection {
+    int fd;
+    uint64_t *indices;      // ring of requests in flight, oldest at head
+    double *sent_at;
+    size_t head;
+    size_t inflight;
+    struct fibd_reply reply;
+    size_t got;             // bytes of the current reply received so far
+    uint8_t *body;
+    size_t body_capacity;
+};
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compare_double(void const *lhs, void const *rhs)
+{
+    double const a = *(double const *)lhs;
+    double const b = *(double const *)rhs;
+    return (a > b) - (a < b);
+}
+
+static int check(uint64_t index, uint8_t const *bytes, size_t length)
+{
+    mpz_t expected, actual;
+    mpz_init(expected);
+    mpz_init(actual);
+    mpz_fib_ui(expected, index);
+    mpz_import(actual, length, -1, 1, 0, 0, bytes);
+    int const same = !mpz_cmp(expected, actual);
+    mpz_clear(expected);
+    mpz_clear(actual);
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    char const *path = FIBD_SOCKET;
+    unsigned nconnections = 4;
+    size_t total = 10000, depth = 16;
+    uint64_t max_index = 10000;
+    int verify = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:n:d:m:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': path = optarg; break;
+            case 'c': nconnections = strtoul(optarg, NULL, 10); break;
+            case 'n': total = strtoull(optarg, NULL, 10); break;
+            case 'd': depth = strtoull(optarg, NULL, 10); break;
+            case 'm': max_index = strtoull(optarg, NULL, 10); break;
+            case 'v': verify = 1; break;
+            default:
+                fprintf(stderr,
+                    "Usage: %s [-s socket] [-c connections] [-n requests]"
+                    " [-d depth] [-m max_index] [-v]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (!nconnections || !depth)
+    {
+        fprintf(stderr, "Connections and depth must be positive.\n");
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    struct connection *conns = calloc(nconnections, sizeof(*conns));
+    struct pollfd *fds = calloc(nconnections, sizeof(*fds));
+    for (unsigned i = 0; i < nconnections; ++i)
+    {
+        conns[i].fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (conns[i].fd < 0 || connect(conns[i].fd, (struct sockaddr *)&addr, sizeof(addr)))
+        {
+            fprintf(stderr, "Failed to connect to %s.\n", path);
+            return EXIT_FAILURE;
+        }
+        conns[i].indices = malloc(depth * sizeof(uint64_t));
+        conns[i].sent_at = malloc(depth * sizeof(double));
+        fds[i].fd = conns[i].fd;
+        fds[i].events = POLLIN;
+    }
+
+    double *latencies = malloc((total ? total : 1) * sizeof(*latencies));
+    size_t nsent = 0, ndone = 0, nwrong = 0, nrefused = 0;
+    uint64_t nbytes = 0;
+    unsigned seed = 42;
+    double const start = now();
+
+    while (ndone < total)
+    {
+        // top every connection up to depth requests in flight
+        for (unsigned i = 0; i < nconnections; ++i)
+        {
+            struct connection *c = &conns[i];
+            uint64_t batch[64];
+            size_t n = 0;
+            while (nsent < total && c->inflight < depth && n < 64)
+            {
+                uint64_t const index = rand_r(&seed) % (max_index + 1);
+                size_t const slot = (c->head + c->inflight++) % depth;
+                c->indices[slot] = index;
+                c->sent_at[slot] = now();
+                batch[n++] = index;
+                ++nsent;
+            }
+            if (n && write(c->fd, batch, n * sizeof(*batch)) != (ssize_t)(n * sizeof(*batch)))
+            {
+                fprintf(stderr, "Failed to send requests.\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (poll(fds, nconnections, -1) < 0)
+        {
+            continue;
+        }
+
+        for (unsigned i = 0; i < nconnections; ++i)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+
+            struct connection *c = &conns[i];
+            ssize_t got;
+            if (c->got < sizeof(c->reply))
+            {
+                got = read(c->fd, (uint8_t *)&c->reply + c->got, sizeof(c->reply) - c->got);
+            }
+            else
+            {
+                size_t const length = c->reply.length == FIBD_REFUSED ? 0 : c->reply.length;
+                if (length > c->body_capacity)
+                {
+                    c->body_capacity = length;
+                    c->body = realloc(c->body, length);
+                }
+                got = read(c->fd, c->body + (c->got - sizeof(c->reply)),
+                    length - (c->got - sizeof(c->reply)));
+            }
+            if (got <= 0)
+            {
+                fprintf(stderr, "Connection closed by fibd.\n");
+                return EXIT_FAILURE;
+            }
+            c->got += got;
+            if (c->got < sizeof(c->reply)
+                || (c->reply.length != FIBD_REFUSED && c->got < sizeof(c->reply) + c->reply.length))
+            {
+                continue;
+            }
+
+            // a whole reply, for the oldest request in flight
+            uint64_t const index = c->indices[c->head];
+            latencies[ndone++] = now() - c->sent_at[c->head];
+            c->head = (c->head + 1) % depth;
+            --c->inflight;
+            if (c->reply.length == FIBD_REFUSED)
+            {
+                ++nrefused;
+                c->got = 0;
+                continue;
+            }
+            nbytes += c->reply.length;
+            if (c->reply.index != index || (verify && !check(index, c->body, c->reply.length)))
+            {
+                ++nwrong;
+            }
+            c->got = 0;
+        }
+    }
+
+    double const wall = now() - start;
+    qsort(latencies, total, sizeof(*latencies), compare_double);
+    fprintf(stderr,
+        "# Requests:   %llu (%llu wrong, %llu refused%s)\n"
+        "# Wall:       %.9fs\n"
+        "# Throughput: %.1f req/s, %.1f MB/s\n",
+        (long long unsigned)total, (long long unsigned)nwrong, (long long unsigned)nrefused, verify ? "" : ", unverified",
+        wall,
+        total / wall, nbytes / wall * 1e-6
+    );
+    if (total)
+    {
+        fprintf(stderr,
+            "# Latency:    p50 %.1fus, p99 %.1fus, max %.1fus\n",
+            latencies[total / 2] * 1e6,
+            latencies[total * 99 / 100] * 1e6,
+            latencies[total - 1] * 1e6
+        );
+    }
+
+    for (unsigned i = 0; i < nconnections; ++i)
+    {
+        close(conns[i].fd);
+        free(conns[i].indices);
+        free(conns[i].sent_at);
+        free(conns[i].body);
+    }
+    free(conns);
+    free(fds);
+    free(latencies);
+    return nwrong ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,356 @@
+"""Fits piecewise power laws to benchmark results and finds the crossovers.
+
+    python3 fit.py [-i impl,...] [-s max_segments] [-b resamples] [-o fib_fit.h] results...
+
+results are files or directories, in any format compare.py reads. Per impl,
+the times below --min-time (timer and call overhead) are dropped, the rest
+binned by index (--bins per decade, median of each bin) and fitted in
+log-log space with a continuous piecewise linear model, t ~ n^e on each
+segment: up to --segments segments, breakpoints searched exhaustively over
+the bins, the number of segments picked by BIC. Confidence intervals (95%)
+come from a residual bootstrap across the bins: the residuals of the fit
+(scaled up for the parameters it spent) resampled onto its fitted values
+at the bin medians, and refitted with the same number of segments. Most
+bins hold a single point, so resampling within them would change nothing.
+
+A crossover is where the fitted curves of two impls meet, within the range
+both were measured on; its interval is that of the matching crossover
+across the bootstrap fits. One that fewer than half the refits reproduce
+is unresolved and gets no interval, and one within a bin of either end of
+that range is left out: one side of it rests on a single bin (F(1) in
+particular, where times are at the timer's resolution). The fastest impl along the index axis, from the
+fitted curves, is written with -o as FIB_DISPATCH_SEEDS (fib_dispatch.h),
+the choice fib_dispatch() starts each index regime with: `make fit`.
+
+app.py draws the same fits (fit_series(), crossovers()).
+"""
+
+import argparse
+import datetime
+import math
+import random
+import socket
+import sys
+
+from compare import load
+
+MIN_BINS = 4            # bins per segment, at least
+LOCAL_SEARCH = 2        # bins a bootstrap refit moves each breakpoint by, at most
+GRID = 400              # points per decade the crossovers are looked for on
+MIN_SHARE = 0.5         # refits a crossover needs to cross too to get an interval
+
+
+def solve(a, b):
+    """x with a x = b, by Gaussian elimination with partial pivoting; None
+    if a is singular."""
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(m[r][col]))
+        if abs(m[pivot][col]) < 1e-12:
+            return None
+        m[col], m[pivot] = m[pivot], m[col]
+        for r in range(col + 1, n):
+            f = m[r][col] / m[col][col]
+            for c in range(col, n + 1):
+                m[r][c] -= f * m[col][c]
+    x = [0.0] * n
+    for r in range(n - 1, -1, -1):
+        x[r] = (m[r][n] - sum(m[r][c] * x[c] for c in range(r + 1, n))) / m[r][r]
+    return x
+
+
+def basis(x, breaks):
+    return [1.0, x] + [max(0.0, x - b) for b in breaks]
+
+
+def least_squares(xs, ys, breaks):
+    """(coefficients, residual sum of squares) of the hinge model."""
+    p = 2 + len(breaks)
+    ata = [[0.0] * p for _ in range(p)]
+    aty = [0.0] * p
+    for x, y in zip(xs, ys):
+        row = basis(x, breaks)
+        for i in range(p):
+            aty[i] += row[i] * y
+            for j in range(i, p):
+                ata[i][j] += row[i] * row[j]
+    for i in range(p):
+        for j in range(i):
+            ata[i][j] = ata[j][i]
+    coef = solve(ata, aty)
+    if coef is None:
+        return None, math.inf
+    sse = sum((y - sum(c * v for c, v in zip(coef, basis(x, breaks)))) ** 2 for x, y in zip(xs, ys))
+    return coef, sse
+
+
+def break_sets(count, k, around=None):
+    """Positions of k breakpoints among count bins, each segment at least
+    MIN_BINS bins long; only within LOCAL_SEARCH of around, if given."""
+    def admissible(positions):
+        edges = [0] + list(positions) + [count - 1]
+        return all(b - a >= MIN_BINS - 1 for a, b in zip(edges, edges[1:]))
+
+    def extend(prefix):
+        if len(prefix) == k:
+            if admissible(prefix):
+                yield tuple(prefix)
+            return
+        i = len(prefix)
+        if around is None:
+            low = prefix[-1] + 1 if prefix else 1
+            candidates = range(low, count - 1)
+        else:
+            candidates = range(max(1, around[i] - LOCAL_SEARCH), min(count - 1, around[i] + LOCAL_SEARCH + 1))
+        for position in candidates:
+            if not prefix or position > prefix[-1]:
+                yield from extend(prefix + [position])
+
+    return extend([])
+
+
+class Fit:
+    """Continuous piecewise linear fit of log(seconds) against log(index)."""
+
+    def __init__(self, coef, breaks, positions, low, high, sse, count):
+        self.coef, self.breaks, self.positions = coef, breaks, positions
+        self.low, self.high = low, high      # log index range fitted
+        self.sse, self.count = sse, count
+
+    def log_time(self, x):
+        return sum(c * v for c, v in zip(self.coef, basis(x, self.breaks)))
+
+    def time(self, index):
+        return math.exp(self.log_time(math.log(index)))
+
+    def exponents(self):
+        """The exponent of each segment, lowest indices first."""
+        slopes, slope = [], self.coef[1]
+        slopes.append(slope)
+        for c in self.coef[2:]:
+            slope += c
+            slopes.append(slope)
+        return slopes
+
+    def segments(self):
+        """(first index, last index, exponent) of each segment."""
+        edges = [self.low] + self.breaks + [self.high]
+        return [(math.exp(a), math.exp(b), e) for a, b, e in zip(edges, edges[1:], self.exponents())]
+
+
+def fit_bins(xs, ys, k, around=None):
+    best = None
+    for positions in break_sets(len(xs), k, around):
+        breaks = [xs[p] for p in positions]
+        coef, sse = least_squares(xs, ys, breaks)
+        if coef is not None and (best is None or sse < best.sse):
+            best = Fit(coef, breaks, positions, xs[0], xs[-1], sse, len(xs))
+    return best
+
+
+def parameters(fit):
+    """Coefficients and breakpoints of the fit."""
+    return 2 + 2 * len(fit.breaks)
+
+
+def bic(fit):
+    return fit.count * math.log(max(fit.sse, 1e-300) / fit.count) + parameters(fit) * math.log(fit.count)
+
+
+def binned(series, min_time, bins_per_decade):
+    """The points of series grouped into log-index bins, [[(log n, log t)...]...]."""
+    bins = {}
+    for index, seconds in series.items():
+        if index >= 1 and seconds >= min_time:
+            key = int(math.floor(math.log10(index) * bins_per_decade))
+            bins.setdefault(key, []).append((math.log(index), math.log(seconds)))
+    return [bins[key] for key in sorted(bins)]
+
+
+def median(values):
+    s = sorted(values)
+    n = len(s)
+    return s[n // 2] if n % 2 else (s[n // 2 - 1] + s[n // 2]) / 2
+
+
+def medians(bins):
+    return [median([x for x, _ in b]) for b in bins], [median([y for _, y in b]) for b in bins]
+
+
+def fit_series(series, min_time=1e-6, bins_per_decade=8, max_segments=3, resamples=0, rng=None):
+    """The best fit of {index: seconds}, and its bootstrap refits; None if
+    there is too little to fit."""
+    bins = binned(series, min_time, bins_per_decade)
+    if len(bins) < MIN_BINS:
+        return None, []
+    xs, ys = medians(bins)
+    fits = [fit_bins(xs, ys, k) for k in range(max_segments) if len(xs) >= MIN_BINS * (k + 1)]
+    fit = min((f for f in fits if f), key=bic)
+
+    # the residuals underestimate the noise by the parameters fitted to it
+    fitted = [fit.log_time(x) for x in xs]
+    residuals = [y - f for y, f in zip(ys, fitted)]
+    spare = len(xs) - parameters(fit)
+    scale = math.sqrt(len(xs) / spare) if spare > 0 else 1.0
+    residuals = [r * scale for r in residuals]
+
+    rng = rng or random.Random(1)
+    boot = []
+    for _ in range(resamples):
+        by = [f + rng.choice(residuals) for f in fitted]
+        refit = fit_bins(xs, by, len(fit.breaks), fit.positions)
+        if refit:
+            boot.append(refit)
+    return fit, boot
+
+
+def crossings(a, b):
+    """Log indices where fits a and b meet, within the range of both."""
+    low, high = max(a.low, b.low), min(a.high, b.high)
+    if high <= low:
+        return []
+    steps = max(2, int((high - low) / math.log(10) * GRID))
+    result = []
+    previous_x, previous = low, a.log_time(low) - b.log_time(low)
+    for i in range(1, steps + 1):
+        x = low + (high - low) * i / steps
+        d = a.log_time(x) - b.log_time(x)
+        if previous == 0 or (previous < 0) != (d < 0):
+            # linear on the grid step, as both are nearly so
+            t = previous / (previous - d) if previous != d else 0
+            result.append(previous_x + t * (x - previous_x))
+        previous_x, previous = x, d
+    return result
+
+
+def percentile(sorted_values, q):
+    if not sorted_values:
+        return math.nan
+    position = q * (len(sorted_values) - 1)
+    lo = int(position)
+    hi = min(lo + 1, len(sorted_values) - 1)
+    return sorted_values[lo] + (sorted_values[hi] - sorted_values[lo]) * (position - lo)
+
+
+def crossovers(fits, boots=None, bins_per_decade=8):
+    """[(slower before, faster after, index, low, high, share of refits
+    that cross too)] over every pair of impls, but those within a bin of
+    either end of the range of both; the interval is nan without bootstrap
+    refits, or if fewer than MIN_SHARE of them cross."""
+    boots = boots or {}
+    names = sorted(fits)
+    result = []
+    for i, a in enumerate(names):
+        for b in names[i + 1:]:
+            edge = math.log(10) / bins_per_decade
+            low, high = max(fits[a].low, fits[b].low), min(fits[a].high, fits[b].high)
+            for x in crossings(fits[a], fits[b]):
+                if x < low + edge or x > high - edge:
+                    continue
+                after = x + 0.01
+                winner, loser = (a, b) if fits[a].log_time(after) < fits[b].log_time(after) else (b, a)
+                nearest = []
+                for fa, fb in zip(boots.get(a, []), boots.get(b, [])):
+                    near = [y for y in crossings(fa, fb) if abs(y - x) < math.log(10) / 2]
+                    if near:
+                        nearest.append(min(near, key=lambda y: abs(y - x)))
+                nearest.sort()
+                share = len(nearest) / max(1, min(len(boots.get(a, [])), len(boots.get(b, []))))
+                resolved = nearest and share >= MIN_SHARE
+                result.append((loser, winner, math.exp(x),
+                               math.exp(percentile(nearest, 0.025)) if resolved else math.nan,
+                               math.exp(percentile(nearest, 0.975)) if resolved else math.nan,
+                               share))
+    result.sort(key=lambda c: c[2])
+    return result
+
+
+def envelope(fits):
+    """[(name, first index)] of the fastest fitted impl along the index axis,
+    each impl only within the range it was measured on."""
+    low = min(f.low for f in fits.values())
+    high = max(f.high for f in fits.values())
+    steps = max(2, int((high - low) / math.log(10) * GRID))
+    result = []
+    for i in range(steps + 1):
+        x = low + (high - low) * i / steps
+        covering = [name for name, f in fits.items() if f.low <= x <= f.high]
+        if not covering:
+            continue
+        best = min(covering, key=lambda name: fits[name].log_time(x))
+        if not result or result[-1][0] != best:
+            result.append((best, 0 if not result else int(math.ceil(math.exp(x)))))
+    return result
+
+
+def write_header(path, seeds, crossed, sources):
+    with open(path, 'w') as out:
+        date = datetime.datetime.now().strftime('%Y-%m-%d %H:%M')
+        out.write('// generated by `make fit` (fit.py) on %s, %s, from %s\n'
+                  % (socket.gethostname(), date, ' '.join(sources)))
+        out.write('#ifndef FIB_FIT_H\n#define FIB_FIT_H\n\n')
+        for loser, winner, index, low, high, share in crossed:
+            interval = 'unresolved' if math.isnan(low) else '95%% CI [%.0f, %.0f]' % (low, high)
+            out.write('// %s overtakes %s at F(%.0f), %s, %.0f%% of refits cross\n'
+                      % (winner, loser, index, interval, 100 * share))
+        out.write('#define FIB_DISPATCH_SEEDS "%s"\n' % ','.join('%s:%d' % s for s in seeds))
+        out.write('\n#endif//FIB_FIT_H\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('results', nargs='+')
+    parser.add_argument('-i', '--impls', help='comma-separated impls to fit (default: all)')
+    parser.add_argument('-s', '--segments', type=int, default=3, help='most segments per fit (default 3)')
+    parser.add_argument('-b', '--resamples', type=int, default=200, help='bootstrap resamples (default 200)')
+    parser.add_argument('-t', '--min-time', type=float, default=1e-6,
+                        help='shortest time fitted, in seconds (default 1e-6)')
+    parser.add_argument('--bins', type=int, default=8, help='bins per decade of index (default 8)')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('-o', '--output', help='header to write FIB_DISPATCH_SEEDS to')
+    args = parser.parse_args()
+
+    series = {}
+    for path in args.results:
+        series.update(load(path)[1])
+    if args.impls:
+        wanted = args.impls.split(',')
+        series = {name: s for name, s in series.items() if name in wanted}
+
+    rng = random.Random(args.seed)
+    fits, boots = {}, {}
+    print('#     Implementation |      First index |       Last index | Exponent |      95% CI')
+    print('# -------------------+------------------+------------------+----------+------------------')
+    for name in sorted(series):
+        fit, boot = fit_series(series[name], args.min_time, args.bins, args.segments, args.resamples, rng)
+        if fit is None:
+            print('# %s: too few points above %g s' % (name, args.min_time), file=sys.stderr)
+            continue
+        fits[name], boots[name] = fit, boot
+        for k, (first, last, exponent) in enumerate(fit.segments()):
+            spread = sorted(b.exponents()[k] for b in boot)
+            print('%20s | %16.0f | %16.0f | %8.3f | [%6.3f, %6.3f]'
+                  % (name, first, last, exponent, percentile(spread, 0.025), percentile(spread, 0.975)))
+    if not fits:
+        return 1
+
+    crossed = crossovers(fits, boots, args.bins)
+    print()
+    print('#      Slower before |      Faster after |        Index |            95% CI            | Refits crossing')
+    print('# -------------------+-------------------+--------------+------------------------------+----------------')
+    for loser, winner, index, low, high, share in crossed:
+        interval = '%28s' % 'unresolved' if math.isnan(low) else '[%12.0f, %12.0f]' % (low, high)
+        print('%20s | %17s | %12.0f | %s | %13.0f%%' % (loser, winner, index, interval, 100 * share))
+
+    seeds = envelope(fits)
+    print()
+    print('# fastest: %s' % ', '.join('%s from %d' % s for s in seeds))
+    if args.output:
+        write_header(args.output, seeds, crossed, args.results)
+        print('# wrote %s' % args.output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
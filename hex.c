@@ -1,17 +1,37 @@
 #include "fib_base.h"
+#include "fib_write.h"
+#include "fib_file.h"
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <time.h>
+#include <unistd.h>
 
 #ifndef CLOCK
 #   define CLOCK CLOCK_PROCESS_CPUTIME_ID
 #endif
 
+static double elapsed(struct timespec const *start, struct timespec const *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc < 2 || argc > 3)
+    // -b writes the raw little-endian bytes instead of hex,
+    // -f a .fib file (see fib_file.h)
+    int const raw = argc > 1 && !strcmp(argv[1], "-b");
+    int const container = argc > 1 && !strcmp(argv[1], "-f");
+    if (raw || container)
+    {
+        --argc;
+        ++argv;
+    }
+
+    if (argc < 2 || argc > 3 || (container && argc != 3))
     {
-        fprintf(stderr, "Usage: %s index [output.hex]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-b] index [output]\n"
+                        "       %s -f index output.fib\n", argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -23,8 +43,11 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    FILE *output_file = argc == 3 ? fopen(argv[2], "w") : stdout;
-    if (output_file == NULL)
+    // read-write, as hex output to a file goes through a mapping; a .fib
+    // file is left alone until fib_file_write() replaces it whole
+    int const to_file = argc == 3 && !container;
+    int output_fd = to_file ? open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+    if (output_fd < 0)
     {
         fprintf(stderr, "Failed to open file: %s\n", argv[2]);
         return EXIT_FAILURE;
@@ -34,35 +57,51 @@ int main(int argc, char *argv[])
     clock_gettime(CLOCK, &start_time);
 
     struct number result = fibonacci(index);
-    uint8_t *bytes = result.bytes;
-    size_t length = result.length;
 
     struct timespec end_time;
     clock_gettime(CLOCK, &end_time);
 
+    struct timespec output_start, output_end;
+    clock_gettime(CLOCK_MONOTONIC, &output_start);
+    int failed;
+    if (container)
+    {
+        failed = fib_file_write(argv[2], index, result);
+    }
+    else if (raw)
+    {
+        failed = fib_write_raw(output_fd, result);
+    }
+    else if (to_file)
+    {
+        failed = fib_write_hex_mapped(output_fd, result);
+    }
+    else
+    {
+        failed = fib_write_hex(output_fd, result, "\n");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &output_end);
+
     fprintf(stderr,
         "# Runtime: %llu.%09llus\n"
-        "# Size:    %llu B\n",
+        "# Size:    %llu B\n"
+        "# Output:  %.9fs\n",
         (long long unsigned)(end_time.tv_sec - start_time.tv_sec),
         (long long unsigned)(end_time.tv_nsec - start_time.tv_nsec),
-        (long long unsigned)length
+        (long long unsigned)result.length,
+        elapsed(&output_start, &output_end)
     );
 
-    do
-    {
-        fprintf(output_file, "%02x", bytes[--length]);
-    }
-    while (length);
-
-    free(bytes);
+    free(result.bytes);
 
-    if (argc == 3)
+    if (to_file)
     {
-        fclose(output_file);
+        failed |= close(output_fd);
     }
-    else
+    if (failed)
     {
-        putc('\n', stdout);
+        fprintf(stderr, "Failed to write the result.\n");
+        return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -1,5 +1,6 @@
 #include "fib_base.h"
 #include <gmp.h>
+#include "fib_control.h"
 
 struct number fibonacci(uint64_t index) {
     
@@ -33,7 +34,19 @@ struct number fibonacci(uint64_t index) {
     mpf_add(phi, phi, sqrt5);
     mpf_div_ui(phi, phi, 2);
 
-    mpf_pow_ui(power, phi, index);
+    // phi^index by squaring, as mpf_pow_ui() would, but checking for
+    // cancellation between steps; progress is in bits of the index
+    unsigned const total = 64 - __builtin_clzll(index);
+    mpf_set_ui(power, 1);
+    for (unsigned done = 1; done <= total; ++done) {
+        mpf_mul(power, power, power);
+        if (index >> (total - done) & 1) {
+            mpf_mul(power, power, phi);
+        }
+        if (fib_progress(done, total)) {
+            goto cancelled;
+        }
+    }
 
     mpf_div(result_float, power, sqrt5);
 
@@ -49,4 +62,9 @@ struct number fibonacci(uint64_t index) {
     mpz_clear(result);
 
     return ret;
+
+cancelled:
+    mpf_clears(sqrt5, phi, power, result_float, half, NULL);
+    mpz_clear(result);
+    return (struct number){ NULL, 0 };
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "fib_base.h"
+#include "fib_control.h"
+#include "fib_opcount.h"
+#include "fib_trace.h"
 
 #if defined(DEBUG) || defined(ONLY64)
 #   define DIGIT uint32_t
@@ -24,6 +27,9 @@ static void scale_accum(
         DIGIT *restrict accum,
         DIGIT const *const a, DBDGT const scale, size_t const ndigits)
 {
+    opcount(LIMB_MULS, ndigits);
+    opcount(LIMB_ADDS, ndigits);
+
     DBDGT carry = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
     {
@@ -43,6 +49,9 @@ static void scale_accum_twice(
         DIGIT *restrict accum1, DIGIT *restrict accum2,
         DIGIT const *const a, DBDGT const scale1, DBDGT const scale2, size_t const ndigits)
 {
+    opcount(LIMB_MULS, 2 * ndigits);
+    opcount(LIMB_ADDS, 2 * ndigits);
+
     DBDGT carry1 = 0;
     DBDGT carry2 = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
@@ -72,6 +81,9 @@ static void scale_accum_dup(
         DIGIT *restrict accum1, DIGIT *restrict accum2,
         DIGIT const *const a, DBDGT const scale, size_t const ndigits)
 {
+    opcount(LIMB_MULS, ndigits);
+    opcount(LIMB_ADDS, 2 * ndigits);
+
     DBDGT carry1 = 0;
     DBDGT carry2 = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
@@ -105,12 +117,19 @@ static size_t multiply(
 {
     for (size_t offset = 0; offset < bdigits; ++offset)
     {
+        // a product cut short is discarded by the caller
+        if (fib_cancelled())
+        {
+            break;
+        }
         scale_accum(&accum[offset], a, b[offset], adigits);
     }
+    trace_begin(scan);
     for (size_t len = adigits + bdigits;; --len)
     {
         if (accum[len])
         {
+            trace_end(scan, "length scan", adigits + bdigits, len + 1);
             return len + 1;
         }
     }
@@ -124,6 +143,10 @@ static void multiply_twice(
 {
     for (size_t offset = 0; offset < maxlen2; ++offset)
     {
+        if (fib_cancelled())
+        {
+            break;
+        }
         scale_accum_twice(&accum1[offset], &accum2[offset], a1, a2[offset], b2[offset], maxlen1);
     }
 }
@@ -136,6 +159,10 @@ static void multiply_dup(
 {
     for (size_t offset = 0; offset < bdigits; ++offset)
     {
+        if (fib_cancelled())
+        {
+            break;
+        }
         scale_accum_dup(&accum1[offset], &accum2[offset], a, b[offset], adigits);
     }
 }
@@ -154,6 +181,8 @@ struct number fibonacci(uint64_t index)
 
     struct number result;
     result.bytes = calloc(3 * TUPLE_LEN * ndigits_max, sizeof(DIGIT));
+    opcount(BYTES_ALLOCATED, 3 * TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+    opcount(BYTES_ZEROED, 3 * TUPLE_LEN * ndigits_max * sizeof(DIGIT));
 
 #   define A(ptr) &(ptr)[0]
 #   define B(ptr) &(ptr)[ndigits_max]
@@ -173,35 +202,69 @@ struct number fibonacci(uint64_t index)
     *A(accum) = 0;
     *B(accum) = 1;
 
-    for (; index; index >>= 1)
+    // progress is in bits of the index, consumed from the bottom
+    unsigned const total = 64 - __builtin_clzll(index | 1);
+    for (unsigned done = 0; index; index >>= 1, ++done)
     {
+        trace_iteration(done);
         if (index & 1)
         {
             // fib *= accum
+            trace_begin(step);
+            trace_begin(clear);
             memset(scratch, 0, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+            opcount(BYTES_ZEROED, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+            trace_end(clear, "memset", TUPLE_LEN * ndigits_max, 0);
 
             // +[ a1a2, a1b2 ]
             // +[ b1b2, b1b2 ]
             // +[    0, b1a2 ]
+            trace_begin(first);
             multiply_twice(A(scratch), B(scratch), A(fib), A(accum), B(accum), fib_len, accum_len);
+            trace_end(first, "a1*(a2,b2)", fib_len, accum_len);
+            trace_begin(second);
             multiply_dup(A(scratch), B(scratch), B(fib), B(accum), fib_len, accum_len);
-            fib_len = multiply(B(scratch), B(fib), A(accum), fib_len, accum_len);
+            trace_end(second, "b1*b2", fib_len, accum_len);
+            trace_begin(third);
+            size_t const product_len = multiply(B(scratch), B(fib), A(accum), fib_len, accum_len);
+            trace_end(third, "b1*a2", fib_len, accum_len);
+            trace_end(step, "fib *= accum", fib_len, accum_len);
+            fib_len = product_len;
             swap(&fib, &scratch);
         }
 
         // accum *= accum
+        trace_begin(step);
+        trace_begin(clear);
         memset(scratch, 0, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+        opcount(BYTES_ZEROED, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+        trace_end(clear, "memset", TUPLE_LEN * ndigits_max, 0);
 
         // +[ a1a2, a1b2 ]
         // +[ b1b2, b1b2 ]
         // +[    0, b1a2 ]
+        trace_begin(first);
         multiply_twice(A(scratch), B(scratch), A(accum), A(accum), B(accum), accum_len, accum_len);
+        trace_end(first, "a*(a,b)", accum_len, accum_len);
+        trace_begin(second);
         multiply_dup(A(scratch), B(scratch), B(accum), B(accum), accum_len, accum_len);
-        accum_len = multiply(B(scratch), B(accum), A(accum), accum_len, accum_len);
+        trace_end(second, "b*b", accum_len, accum_len);
+        trace_begin(third);
+        size_t const square_len = multiply(B(scratch), B(accum), A(accum), accum_len, accum_len);
+        trace_end(third, "b*a", accum_len, accum_len);
+        trace_end(step, "accum *= accum", accum_len, accum_len);
+        accum_len = square_len;
         swap(&accum, &scratch);
+
+        if (fib_progress(done + 1, total))
+        {
+            free(result.bytes);
+            return (struct number){ NULL, 0 };
+        }
     }
 
     result.length = fib_len * sizeof(DIGIT);
     memcpy(result.bytes, B(fib), result.length);
+    opcount(BYTES_COPIED, result.length);
     return result;
 }
@@ -1,4 +1,11 @@
 #include "fib_base.h"
+#include "fib_control.h"
+#include "fib_opcount.h"
+#include "fib_trace.h"
+#include "fib_checkpoint.h"
+#include "fib_store.h"
+#include "fib_batch.h"
+#include "fib_workers.h"
 
 #if defined(DEBUG) || defined(ONLY64)
 #   define DIGIT uint32_t
@@ -26,6 +33,8 @@ static unsigned sum(
         DIGIT const *const a, DIGIT const *const b,
         size_t const ndigits)
 {
+    opcount(LIMB_ADDS, ndigits);
+
     size_t offset;
     unsigned carry = 0;
     for (offset = 0; offset < ndigits; offset += 2)
@@ -35,10 +44,12 @@ static unsigned sum(
         carry += __builtin_add_overflow(*(DBDGT *)&b[offset], tot, (DBDGT *)&result[offset]);
     }
     result[offset] = carry;
+    trace_begin(scan);
     for (;; --offset)
     {
         if (result[offset])
         {
+            trace_end(scan, "length scan", ndigits + 1, offset + 1);
             return offset + 1;
         }
     }
@@ -49,6 +60,9 @@ static void scale_accum_dup(
         DIGIT *restrict accum1, DIGIT *restrict accum2,
         DIGIT const *const a, DBDGT const scale, size_t const ndigits)
 {
+    opcount(LIMB_MULS, ndigits);
+    opcount(LIMB_ADDS, 2 * ndigits);
+
     DBDGT carry1 = 0;
     DBDGT carry2 = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
@@ -78,6 +92,9 @@ static void scale_accum_twice(
         DIGIT *restrict accum1, DIGIT *restrict accum2,
         DIGIT const *const a, DBDGT const scale1, DBDGT const scale2, size_t const ndigits)
 {
+    opcount(LIMB_MULS, 2 * ndigits);
+    opcount(LIMB_ADDS, 2 * ndigits);
+
     DBDGT carry1 = 0;
     DBDGT carry2 = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
@@ -109,6 +126,11 @@ static void square_dup(
 {
     for (size_t offset = 0; offset < adigits; ++offset)
     {
+        // a product cut short is discarded by the caller
+        if (fib_cancelled())
+        {
+            break;
+        }
         scale_accum_dup(&accum1[offset], &accum2[offset], a, a[offset], adigits);
     }
 }
@@ -123,20 +145,95 @@ static size_t multiply_twice(
     unsigned b_spill = 0;
     for (size_t offset = 0; offset < maxlen2 || b_spill; ++offset)
     {
+        if (fib_cancelled())
+        {
+            break;
+        }
         DIGIT const b = b2[offset];
         unsigned const next_spill = b >> (DIGIT_BIT-1);
         scale_accum_twice(&accum1[offset], &accum2[offset], a1, a2[offset], (b << 1) | b_spill, maxlen1);
         b_spill = next_spill;
     }
+    trace_begin(scan);
     for (size_t len = maxlen1 + maxlen2;; --len)
     {
         if (accum1[len] || accum2[len])
         {
+            trace_end(scan, "length scan", maxlen1 + maxlen2, len + 1);
             return len + 1;
         }
     }
 }
 
+// computes 2 * (*a) + (*b)
+// returns number of digits in the result
+static size_t twice_sum(
+        DIGIT *restrict result,
+        DIGIT const *const a, DIGIT const *const b,
+        size_t const ndigits)
+{
+    // 2a counts as a + a
+    opcount(LIMB_ADDS, 2 * ndigits);
+
+    DBDGT carry = 0;
+    for (size_t offset = 0; offset < ndigits; ++offset)
+    {
+        DBDGT const acc = 2 * (DBDGT)a[offset] + b[offset] + carry;
+        result[offset] = (DIGIT)acc;
+        carry = acc >> DIGIT_BIT;
+    }
+    result[ndigits] = (DIGIT)carry;
+    return ndigits + (carry != 0);
+}
+
+// computes (*a) * scale and accumulates the result in accum
+static void scale_accum(
+        DIGIT *restrict accum,
+        DIGIT const *const a, DBDGT const scale, size_t const ndigits)
+{
+    opcount(LIMB_MULS, ndigits);
+    opcount(LIMB_ADDS, ndigits);
+
+    DBDGT carry = 0;
+    for (size_t offset = 0; offset < ndigits; ++offset)
+    {
+        DBDGT const acc
+            = ((DBDGT)accum[offset])
+            + ((DBDGT)a[offset]) * scale
+            + carry;
+        accum[offset] = (DIGIT)acc;
+        carry = acc >> DIGIT_BIT;
+    }
+    *(DBDGT *)&accum[ndigits] += carry;
+}
+
+// one product of a parallel squaring step: accum += a * b
+struct product
+{
+    DIGIT *accum;
+    DIGIT const *a;
+    DIGIT const *b;
+    size_t adigits;
+    size_t bdigits;
+    int64_t iteration;  // for the trace, as the helpers have their own
+};
+
+static void multiply_acc(void *arg)
+{
+    struct product const *p = arg;
+    trace_iteration(p->iteration);
+    trace_begin(product);
+    for (size_t offset = 0; offset < p->bdigits; ++offset)
+    {
+        if (fib_cancelled())
+        {
+            break;
+        }
+        scale_accum(&p->accum[offset], p->a, p->b[offset], p->adigits);
+    }
+    trace_end(product, "product", p->adigits, p->bdigits);
+}
+
 // as the name suggests
 static void swap(DIGIT **lhs, DIGIT **rhs)
 {
@@ -157,9 +254,12 @@ struct number fibonacci(uint64_t index)
     size_t ndigits_max = ndigit_estimate(index);
 
     uint64_t mask = msb(index);
+    unsigned const total = 64 - __builtin_clzll(index | 1);
 
     struct number result;
     result.bytes = calloc(2 * TUPLE_LEN * ndigits_max, sizeof(DIGIT));
+    opcount(BYTES_ALLOCATED, 2 * TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+    opcount(BYTES_ZEROED, 2 * TUPLE_LEN * ndigits_max * sizeof(DIGIT));
 
 #   define A(ptr) &(ptr)[0]
 #   define B(ptr) &(ptr)[ndigits_max]
@@ -173,37 +273,244 @@ struct number fibonacci(uint64_t index)
     *A(fib) = 1;
     *B(fib) = 0;
 
+    // pick up a checkpoint of this computation if asked to, or else skip
+    // the leading "1 followed by k zeros" if the store has F(2^k)
+    struct fib_checkpointer cp;
+    fib_checkpoint_begin(&cp);
+    struct number saved[2];
+    uint64_t saved_mask;
+    struct fib_store const *store = fib_store_default();
+    int const k = fib_store_prefix(store, index);
+    if (!fib_checkpoint_resume(FIB_CHECKPOINT_FASTSQUARING, index, &saved_mask, saved))
+    {
+        size_t const length = saved[0].length > saved[1].length ? saved[0].length : saved[1].length;
+        if (length <= ndigits_max * sizeof(DIGIT))
+        {
+            memcpy(A(fib), saved[0].bytes, saved[0].length);
+            memcpy(B(fib), saved[1].bytes, saved[1].length);
+            opcount(BYTES_COPIED, saved[0].length + saved[1].length);
+            fib_len = (length + sizeof(DIGIT) - 1) / sizeof(DIGIT);
+            mask = saved_mask;
+            log("resuming with mask %llx\n", (long long unsigned)mask);
+        }
+        free(saved[0].bytes);
+        free(saved[1].bytes);
+    }
+    else if (k > 0)
+    {
+        struct number const prev = fib_store_value(store, k, -1);
+        struct number const cur = fib_store_value(store, k, 0);
+        memcpy(A(fib), prev.bytes, prev.length);
+        memcpy(B(fib), cur.bytes, cur.length);
+        opcount(BYTES_COPIED, prev.length + cur.length);
+        fib_len = (cur.length + sizeof(DIGIT) - 1) / sizeof(DIGIT);
+        mask >>= k + 1;
+    }
+
+    // a^2, b^2 and b(2a+b) for the parallel path, which engages past
+    // FIB_PARALLEL_LIMBS if there are helpers
+    DIGIT *work = NULL;
+    if (ndigits_max * sizeof(DIGIT) >= FIB_PARALLEL_LIMBS * sizeof(uint64_t) && fib_workers_available())
+    {
+        work = malloc(3 * ndigits_max * sizeof(DIGIT));
+        opcount(BYTES_ALLOCATED, 3 * ndigits_max * sizeof(DIGIT));
+    }
+
     for (; mask; mask >>= 1)
     {
+        int64_t const iteration = total - 1 - __builtin_ctzll(mask);
+        trace_iteration(iteration);
+
         // fib *= fib
+        trace_begin(step);
+        trace_begin(clear);
         memset(scratch, 0, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+        opcount(BYTES_ZEROED, TUPLE_LEN * ndigits_max * sizeof(DIGIT));
+        trace_end(clear, "memset", TUPLE_LEN * ndigits_max, 0);
 
-        // +[ b^2, b^2 ]
-        // +[ a^2, 2ab ]
-        square_dup(A(scratch), B(scratch), B(fib), fib_len);
-        debugmem(B(fib), fib_len * sizeof(DIGIT));
-        debug(" **2 + 2 * ");
-        debugmem(A(fib), fib_len * sizeof(DIGIT));
-        debug(" * ");
-        debugmem(B(fib), fib_len * sizeof(DIGIT));
-        debug(" = ");
-        fib_len = multiply_twice(A(scratch), B(scratch), A(fib), A(fib), B(fib), fib_len, fib_len);
-        debugmem(B(scratch), fib_len * sizeof(DIGIT));
-        debug("\n");
-        log("fib_len: %llu\n", (long long unsigned)fib_len);
-        swap(&fib, &scratch);
+        if (work && fib_len * sizeof(DIGIT) >= FIB_PARALLEL_LIMBS * sizeof(uint64_t))
+        {
+            // [a^2 + b^2, b(2a + b)], as three independent products
+            DIGIT *const sq_a = &work[0];
+            DIGIT *const sq_b = &work[ndigits_max];
+            DIGIT *const t = &work[2 * ndigits_max];
+            trace_begin(clear_work);
+            memset(sq_a, 0, (2 * fib_len + 2) * sizeof(DIGIT));
+            memset(sq_b, 0, (2 * fib_len + 2) * sizeof(DIGIT));
+            opcount(BYTES_ZEROED, 2 * (2 * fib_len + 2) * sizeof(DIGIT));
+            trace_end(clear_work, "memset", 2 * (2 * fib_len + 2), 0);
+            trace_begin(twice);
+            size_t const t_len = twice_sum(t, A(fib), B(fib), fib_len);
+            trace_end(twice, "2a+b", fib_len, t_len);
+
+            struct product products[3] = {
+                { B(scratch), B(fib), t, fib_len, t_len, iteration },
+                { sq_a, A(fib), A(fib), fib_len, fib_len, iteration },
+                { sq_b, B(fib), B(fib), fib_len, fib_len, iteration },
+            };
+            struct fib_job const jobs[3] = {
+                { multiply_acc, &products[0] },
+                { multiply_acc, &products[1] },
+                { multiply_acc, &products[2] },
+            };
+            trace_begin(products_span);
+            fib_workers_run(jobs, 3);
+            trace_end(products_span, "parallel products", fib_len, t_len);
+
+            trace_begin(add);
+            sum(A(scratch), sq_a, sq_b, 2 * fib_len);
+            trace_end(add, "a^2+b^2", 2 * fib_len, 2 * fib_len);
+            // b(2a + b) may be a digit short of fib_len + t_len
+            trace_end(step, "fib *= fib", fib_len, t_len);
+            trace_begin(scan);
+            fib_len += t_len;
+            while (!(B(scratch))[fib_len - 1])
+            {
+                --fib_len;
+            }
+            trace_end(scan, "length scan", t_len, fib_len);
+            log("fib_len: %llu\n", (long long unsigned)fib_len);
+            swap(&fib, &scratch);
+        }
+        else
+        {
+            // +[ b^2, b^2 ]
+            // +[ a^2, 2ab ]
+            trace_begin(square);
+            square_dup(A(scratch), B(scratch), B(fib), fib_len);
+            trace_end(square, "b^2", fib_len, fib_len);
+            debugmem(B(fib), fib_len * sizeof(DIGIT));
+            debug(" **2 + 2 * ");
+            debugmem(A(fib), fib_len * sizeof(DIGIT));
+            debug(" * ");
+            debugmem(B(fib), fib_len * sizeof(DIGIT));
+            debug(" = ");
+            trace_begin(cross);
+            size_t const square_len = multiply_twice(A(scratch), B(scratch), A(fib), A(fib), B(fib), fib_len, fib_len);
+            trace_end(cross, "a*(a,2b)", fib_len, fib_len);
+            trace_end(step, "fib *= fib", fib_len, fib_len);
+            fib_len = square_len;
+            debugmem(B(scratch), fib_len * sizeof(DIGIT));
+            debug("\n");
+            log("fib_len: %llu\n", (long long unsigned)fib_len);
+            swap(&fib, &scratch);
+        }
 
         if (index & mask)
         {
             // [b, a+b]
+            trace_begin(copy);
             memcpy(A(scratch), B(fib), fib_len * sizeof(DIGIT));
+            opcount(BYTES_COPIED, fib_len * sizeof(DIGIT));
+            trace_end(copy, "memcpy", fib_len, 0);
             //fib_len += sum((DBDGT *)B(scratch), (DBDGT *)A(fib), (DBDGT *)B(fib), fib_len);
-            fib_len = sum(B(scratch), A(fib), B(fib), fib_len);
+            trace_begin(add);
+            size_t const sum_len = sum(B(scratch), A(fib), B(fib), fib_len);
+            trace_end(add, "a+b", fib_len, fib_len);
+            fib_len = sum_len;
             swap(&fib, &scratch);
         }
+
+        // progress is in bits of the index, consumed from the top
+        if (fib_progress(total - __builtin_ctzll(mask), total))
+        {
+            free(work);
+            free(result.bytes);
+            return (struct number){ NULL, 0 };
+        }
+
+        if (fib_checkpoint_due(&cp))
+        {
+            struct number const state[2] = {
+                { A(fib), fib_len * sizeof(DIGIT) },
+                { B(fib), fib_len * sizeof(DIGIT) },
+            };
+            fib_checkpoint_save(&cp, FIB_CHECKPOINT_FASTSQUARING, index, mask >> 1, state);
+        }
     }
 
+    free(work);
     result.length = fib_len * sizeof(DIGIT);
     memcpy(result.bytes, B(fib), result.length);
+    opcount(BYTES_COPIED, result.length);
     return result;
 }
+
+// copy of B(fib), as returned by fibonacci()
+static struct number to_number(DIGIT const *const b, size_t const fib_len)
+{
+    struct number result;
+    result.length = fib_len * sizeof(DIGIT);
+    result.bytes = malloc(result.length);
+    memcpy(result.bytes, b, result.length);
+    opcount(BYTES_ALLOCATED, result.length);
+    opcount(BYTES_COPIED, result.length);
+    return result;
+}
+
+// fib holds (F(m-1), F(m)) for the depth-bit prefix m shared by items[lo, hi),
+// in two fields of ndigits_max digits
+static void walk(
+        DIGIT const *const fib, size_t const fib_len, size_t const ndigits_max,
+        struct fib_batch_item const *const items, size_t lo, size_t const hi,
+        unsigned const depth, struct number *const outputs)
+{
+    size_t const start = fib_batch_skip(items, lo, hi, depth);
+    for (; lo < start; ++lo)
+    {
+        outputs[items[lo].slot] = to_number(B(fib), fib_len);
+    }
+    if (lo == hi)
+    {
+        return;
+    }
+
+    // children are 2m and 2m+1, size their fields for the larger one
+    uint64_t const prefix = depth ? items[lo].key >> (64 - depth) : 0;
+    size_t const child_max = ndigit_estimate(2 * prefix + 1);
+    size_t const mid = fib_batch_split(items, lo, hi, depth);
+
+    DIGIT *even = calloc(TUPLE_LEN * child_max, sizeof(DIGIT));
+    DIGIT *odd = mid < hi ? calloc(TUPLE_LEN * child_max, sizeof(DIGIT)) : NULL;
+    opcount(BYTES_ALLOCATED, (odd ? 2 : 1) * TUPLE_LEN * child_max * sizeof(DIGIT));
+    opcount(BYTES_ZEROED, (odd ? 2 : 1) * TUPLE_LEN * child_max * sizeof(DIGIT));
+
+    // one squaring serves both children:
+    // 2m is (F(2m-1), F(2m)), 2m+1 is (F(2m), F(2m+1))
+    square_dup(&even[0], &even[child_max], B(fib), fib_len);
+    size_t const even_len = multiply_twice(&even[0], &even[child_max], A(fib), A(fib), B(fib), fib_len, fib_len);
+
+    if (odd)
+    {
+        memcpy(&odd[0], &even[child_max], even_len * sizeof(DIGIT));
+        opcount(BYTES_COPIED, even_len * sizeof(DIGIT));
+        size_t const odd_len = sum(&odd[child_max], &even[0], &even[child_max], even_len);
+        walk(odd, odd_len, child_max, items, mid, hi, depth + 1, outputs);
+        free(odd);
+    }
+    if (lo < mid)
+    {
+        walk(even, even_len, child_max, items, lo, mid, depth + 1, outputs);
+    }
+    free(even);
+}
+
+void fibonacci_many(uint64_t const *indices, size_t count, struct number *outputs)
+{
+    struct fib_batch_item *items = fib_batch_sort(indices, count);
+    if (!items)
+    {
+        // no memory for the trie: one at a time, with no prefix shared
+        for (size_t i = 0; i < count; ++i)
+        {
+            outputs[i] = fibonacci(indices[i]);
+        }
+        return;
+    }
+
+    // (F(-1), F(0)), as in fibonacci()
+    DIGIT identity[TUPLE_LEN * 2] = { 1, 0, 0, 0 };
+    walk(identity, 1, 2, items, 0, count, 0, outputs);
+
+    free(items);
+}
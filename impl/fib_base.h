@@ -40,4 +40,10 @@ struct number {
 // See impl/README.md for an explanation of the function's expected behaviour.
 struct number fibonacci(uint64_t index);
 
+// Computes outputs[i] = fibonacci(indices[i]) for i < count, walking the
+// doubling steps shared by indices with a common binary prefix only once.
+// Provided by the impls that consume the index from the top bit down
+// (fastsquaring, gmp2).
+void fibonacci_many(uint64_t const *indices, size_t count, struct number *outputs);
+
 #endif//FIB_BASE_H
@@ -1,15 +1,23 @@
 #include <gmp.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include "fib_base.h"
+#include "fib_control.h"
 
 typedef struct {
     uint64_t key;
     mpz_t value;
 } DpEntry;
 
-DpEntry *dp = NULL;
-int dp_size = 0;
-int dp_capacity = 0;
+static DpEntry *dp = NULL;
+static int dp_size = 0;
+static int dp_capacity = 0;
+
+// bit length of the index being computed, for progress reports
+static unsigned index_bits;
+
+// dp and index_bits are shared by every call, so concurrent calls take turns
+static pthread_mutex_t dp_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void dp_init() {
     dp_capacity = 10;
@@ -51,12 +59,21 @@ static void F(mpz_t result, uint64_t n) {
         return;
     }
 
+    if (fib_cancelled()) {
+        return;
+    }
+
     uint64_t k = n / 2;
     mpz_t Fk, Fk1;
     mpz_init(Fk);
     mpz_init(Fk1);
     F(Fk, k);
     F(Fk1, k - 1);
+    if (fib_cancelled()) {
+        mpz_clear(Fk);
+        mpz_clear(Fk1);
+        return;
+    }
 
     if (n % 2 == 0) {
         mpz_t temp;
@@ -84,12 +101,16 @@ static void F(mpz_t result, uint64_t n) {
         mpz_clear(term1);
         mpz_clear(term2);
     }
-    dp_add(n, result);
+    // a result built on a cancelled subcall is wrong, keep it out of dp
+    if (!fib_progress(64 - __builtin_clzll(n), index_bits)) {
+        dp_add(n, result);
+    }
     mpz_clear(Fk);
     mpz_clear(Fk1);
 }
 
 struct number fibonacci(uint64_t index) {
+    pthread_mutex_lock(&dp_lock);
     static int dp_initialized = 0;
     if (!dp_initialized) {
         dp_init();
@@ -98,7 +119,13 @@ struct number fibonacci(uint64_t index) {
 
     mpz_t fib;
     mpz_init(fib);
+    index_bits = 64 - __builtin_clzll(index | 1);
     F(fib, index);
+    pthread_mutex_unlock(&dp_lock);
+    if (fib_cancelled()) {
+        mpz_clear(fib);
+        return (struct number){ NULL, 0 };
+    }
 
     size_t count;
     void *bytes = mpz_export(NULL, &count, -1, 1, 0, 0, fib);
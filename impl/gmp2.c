@@ -1,11 +1,77 @@
 #include <gmp.h>
 #include <stdlib.h>
 #include "fib_base.h"
+#include "fib_store.h"
+#include "fib_batch.h"
+#include "fib_workers.h"
+#include "fib_control.h"
+#include "fib_checkpoint.h"
+#include "fib_trace.h"
 
-static void fast_doubling(mpz_t result, uint64_t n) {
+struct product {
+    char const *name;  // for the trace
+    mpz_ptr result;
+    mpz_srcptr lhs;
+    mpz_srcptr rhs;
+    int64_t iteration;  // for the trace, as the helpers have their own
+};
+
+static void run_product(void *arg) {
+    struct product *p = arg;
+    // mpz_mul cannot be interrupted, but a cancelled step need not start
+    // the products it will throw away
+    if (fib_cancelled()) {
+        return;
+    }
+    trace_iteration(p->iteration);
+    trace_begin(product);
+    mpz_mul(p->result, p->lhs, p->rhs);
+    trace_end(product, p->name, mpz_size(p->lhs), mpz_size(p->rhs));
+}
+
+// (c, d) = (F(2k), F(2k+1)) from (a, b) = (F(k), F(k+1)); clobbers b.
+// iteration is what the spans of the products are stamped with.
+static void double_step(mpz_t a, mpz_t b, mpz_t c, mpz_t d, int64_t iteration) {
+    // F(2k) = F(k) * [2 * F(k+1) - F(k)]
+    // F(2k+1) = F(k)^2 + F(k+1)^2
+    trace_begin(step);
+    trace_begin(linear);
+    mpz_mul_2exp(c, b, 1);  // c = 2 * F(k+1)
+    mpz_sub(c, c, a);       // c = 2 * F(k+1) - F(k)
+    trace_end(linear, "2b-a", mpz_size(b), mpz_size(a));
+
+    // the three products are independent, so large ones go to the helpers
+    struct product products[3] = {
+        { "a*(2b-a)", c, c, a, iteration },  // c = F(2k)
+        { "a^2", d, a, a, iteration },       // d = F(k)^2
+        { "b^2", b, b, b, iteration },       // b = F(k+1)^2
+    };
+    if (mpz_size(a) >= FIB_PARALLEL_GMP_LIMBS && fib_workers_available()) {
+        struct fib_job const jobs[3] = {
+            { run_product, &products[0] },
+            { run_product, &products[1] },
+            { run_product, &products[2] },
+        };
+        trace_begin(parallel);
+        fib_workers_run(jobs, 3);
+        trace_end(parallel, "parallel products", mpz_size(a), mpz_size(c));
+    } else {
+        for (int i = 0; i < 3; i++) {
+            run_product(&products[i]);
+        }
+    }
+
+    trace_begin(add);
+    mpz_add(d, d, b);  // d = F(2k+1)
+    trace_end(add, "a^2+b^2", mpz_size(d), mpz_size(b));
+    trace_end(step, "double step", mpz_size(a), mpz_size(d));
+}
+
+// returns nonzero, leaving result unset, if cancelled
+static int fast_doubling(mpz_t result, uint64_t n) {
     if (n == 0) {
         mpz_set_ui(result, 0);
-        return;
+        return 0;
     }
 
     mpz_t a, b, c, d;
@@ -16,40 +82,68 @@ static void fast_doubling(mpz_t result, uint64_t n) {
     mpz_set_ui(b, 1);  // F(1) = 1
 
     uint64_t mask = 1ULL << (63 - __builtin_clzll(n));  // Highest set bit
+    unsigned const total = 64 - __builtin_clzll(n);
+
+    // Pick up a checkpoint of this computation if asked to, or else skip
+    // the leading "1 followed by k zeros" if the store has F(2^k)
+    struct fib_checkpointer cp;
+    fib_checkpoint_begin(&cp);
+    struct number saved[2];
+    uint64_t saved_mask;
+    struct fib_store const *store = fib_store_default();
+    int k = fib_store_prefix(store, n);
+    if (!fib_checkpoint_resume(FIB_CHECKPOINT_GMP2, n, &saved_mask, saved)) {
+        mpz_import(a, saved[0].length, -1, 1, 0, 0, saved[0].bytes);
+        mpz_import(b, saved[1].length, -1, 1, 0, 0, saved[1].bytes);
+        free(saved[0].bytes);
+        free(saved[1].bytes);
+        mask = saved_mask;
+        log("resuming with mask %llx\n", (long long unsigned)mask);
+    } else if (k > 0) {
+        struct number fk = fib_store_value(store, k, 0);
+        struct number fk1 = fib_store_value(store, k, 1);
+        mpz_import(a, fk.length, -1, 1, 0, 0, fk.bytes);   // a = F(2^k)
+        mpz_import(b, fk1.length, -1, 1, 0, 0, fk1.bytes); // b = F(2^k+1)
+        mask >>= k + 1;
+    }
 
     for (; mask; mask >>= 1) {
-        // Calculate F(2k) = F(k) * [2 * F(k+1) - F(k)]
-        mpz_mul(c, a, a);  // c = F(k)^2
-        mpz_mul(d, b, b);  // d = F(k+1)^2
-        mpz_add(d, d, c);  // d = F(k)^2 + F(k+1)^2
+        int64_t const iteration = total - 1 - __builtin_ctzll(mask);
+        trace_iteration(iteration);
+        double_step(a, b, c, d, iteration);
 
         if (n & mask) {
-            // F(2k+1) = F(k+1)^2 + F(k)^2
-            mpz_add(c, c, d);  // c = F(k)^2 + (F(k)^2 + F(k+1)^2)
+            trace_begin(add);
+            mpz_add(b, c, d);  // b = F(2k+2)
+            trace_end(add, "a+b", mpz_size(c), mpz_size(d));
             mpz_swap(a, d);    // a = F(2k+1)
-            mpz_swap(b, c);    // b = F(2k+2)
         } else {
-            // F(2k) = F(k) * [2 * F(k+1) - F(k)]
-            mpz_sub(d, d, c);  // d = (F(k)^2 + F(k+1)^2) - F(k)^2 = F(k+1)^2
             mpz_swap(a, c);    // a = F(2k)
             mpz_swap(b, d);    // b = F(2k+1)
         }
+
+        // progress is in bits of n, consumed from the top
+        if (fib_progress(total - __builtin_ctzll(mask), total)) {
+            mpz_clears(a, b, c, d, NULL);
+            return -1;
+        }
+
+        // the limbs are saved in place, (a, b) = (F(m), F(m+1))
+        if (fib_checkpoint_due(&cp)) {
+            struct number const state[2] = {
+                { (void *)mpz_limbs_read(a), mpz_size(a) * sizeof(mp_limb_t) },
+                { (void *)mpz_limbs_read(b), mpz_size(b) * sizeof(mp_limb_t) },
+            };
+            fib_checkpoint_save(&cp, FIB_CHECKPOINT_GMP2, n, mask >> 1, state);
+        }
     }
 
     mpz_set(result, a);  // Result is in a
     mpz_clears(a, b, c, d, NULL);
+    return 0;
 }
 
-struct number fibonacci(uint64_t index) {
-    mpz_t fib;
-    mpz_init(fib);
-
-    if (index == 0) {
-        mpz_set_ui(fib, 0);  // F(0) = 0
-    } else {
-        fast_doubling(fib, index);
-    }
-
+static struct number to_number(mpz_t const fib) {
     size_t count;
     void *bytes = mpz_export(NULL, &count, -1, 1, 0, 0, fib);
 
@@ -63,11 +157,76 @@ struct number fibonacci(uint64_t index) {
         .bytes = (unsigned char *)bytes,
         .length = count
     };
+    return ret;
+}
+
+struct number fibonacci(uint64_t index) {
+    mpz_t fib;
+    mpz_init(fib);
 
+    if (index == 0) {
+        mpz_set_ui(fib, 0);  // F(0) = 0
+    } else if (fast_doubling(fib, index)) {
+        mpz_clear(fib);
+        return (struct number){ NULL, 0 };
+    }
+
+    struct number ret = to_number(fib);
     mpz_clear(fib);
     return ret;
 }
 
+// (a, b) = (F(m), F(m+1)) for the depth-bit prefix m shared by items[lo, hi);
+// both are clobbered
+static void walk(mpz_t a, mpz_t b, struct fib_batch_item const *items,
+        size_t lo, size_t hi, unsigned depth, struct number *outputs) {
+    size_t const start = fib_batch_skip(items, lo, hi, depth);
+    for (; lo < start; ++lo) {
+        outputs[items[lo].slot] = to_number(a);
+    }
+    if (lo == hi) {
+        return;
+    }
+
+    size_t const mid = fib_batch_split(items, lo, hi, depth);
+    mpz_t c, d;
+    mpz_inits(c, d, NULL);
+    trace_iteration(depth);
+    double_step(a, b, c, d, depth);
+
+    // one doubling serves both children:
+    // 2m is (F(2m), F(2m+1)), 2m+1 is (F(2m+1), F(2m+2))
+    if (mid < hi) {
+        mpz_set(a, d);
+        mpz_add(b, c, d);
+        walk(a, b, items, mid, hi, depth + 1, outputs);
+    }
+    if (lo < mid) {
+        walk(c, d, items, lo, mid, depth + 1, outputs);
+    }
+
+    mpz_clears(c, d, NULL);
+}
+
+void fibonacci_many(uint64_t const *indices, size_t count, struct number *outputs) {
+    struct fib_batch_item *items = fib_batch_sort(indices, count);
+    if (!items) {
+        // no memory for the trie: one at a time, with no prefix shared
+        for (size_t i = 0; i < count; ++i) {
+            outputs[i] = fibonacci(indices[i]);
+        }
+        return;
+    }
+
+    mpz_t a, b;
+    mpz_init_set_ui(a, 0);  // F(0) = 0
+    mpz_init_set_ui(b, 1);  // F(1) = 1
+    walk(a, b, items, 0, count, 0, outputs);
+
+    mpz_clears(a, b, NULL);
+    free(items);
+}
+
 void fibonacci_cleanup() {
     // No cleanup needed
 }
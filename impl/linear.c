@@ -1,4 +1,6 @@
 #include "fib_base.h"
+#include "fib_control.h"
+#include "fib_opcount.h"
 
 #ifdef DEBUG
 #   define DIGIT uint64_t
@@ -8,6 +10,9 @@
 
 #define DIGIT_BIT (CHAR_BIT * sizeof(DIGIT))
 
+// additions between two progress reports
+#define PROGRESS_MASK 0x3ff
+
 static size_t ndigit_estimate(uint64_t const index)
 {
     return (index + DIGIT_BIT - 1) / DIGIT_BIT + 1;
@@ -17,6 +22,9 @@ static unsigned accumulate(
         DIGIT *restrict a,
         DIGIT const *const b, size_t const ndigits)
 {
+    // in 64-bit limbs, whatever the digit size
+    opcount(LIMB_ADDS, ndigits * sizeof(DIGIT) / sizeof(uint64_t));
+
     unsigned carry = 0;
     for (size_t offset = 0; offset < ndigits; ++offset)
     {
@@ -44,19 +52,27 @@ struct number fibonacci(uint64_t index)
 
     struct number result;
     result.bytes = calloc(2 * ndigits_max, sizeof(DIGIT));
+    opcount(BYTES_ALLOCATED, 2 * ndigits_max * sizeof(DIGIT));
+    opcount(BYTES_ZEROED, 2 * ndigits_max * sizeof(DIGIT));
     DIGIT *cur = result.bytes;
     DIGIT *next = &cur[ndigits_max];
     *next = 1;
 
     size_t ndigits = 1;
-    while (index--)
+    for (uint64_t done = 0; done < index; ++done)
     {
+        if (!(done & PROGRESS_MASK) && fib_progress(done, index))
+        {
+            free(result.bytes);
+            return (struct number){ NULL, 0 };
+        }
         ndigits += accumulate(next, cur, ndigits);
         swap(&cur, &next);
     }
 
     result.length = ndigits * sizeof(DIGIT);
     memcpy(result.bytes, cur, result.length);
+    opcount(BYTES_COPIED, result.length);
     return result;
 }
 
@@ -1,19 +1,36 @@
 #include "fib_base.h"
+#include "fib_control.h"
+#include "fib_opcount.h"
 
 #define GENEROUS_BYTE_LIMIT sizeof(uint64_t)
 
-uint64_t fibonacci_naive(uint64_t index)
+// subtrees from this size on check for cancellation (~50k calls each)
+#define CHECK_INDEX 24
+
+static uint64_t fibonacci_naive(uint64_t index)
 {
     if (index <= 1)
     {
         return index;
     }
+    if (index >= CHECK_INDEX && fib_progress(0, 0))
+    {
+        return 0;
+    }
+    opcount(LIMB_ADDS, 1);
     return fibonacci_naive(index-1) + fibonacci_naive(index-2);
 }
 
 struct number fibonacci(uint64_t index)
 {
     uint64_t *bytes = calloc(1, GENEROUS_BYTE_LIMIT);
+    opcount(BYTES_ALLOCATED, GENEROUS_BYTE_LIMIT);
+    opcount(BYTES_ZEROED, GENEROUS_BYTE_LIMIT);
     *bytes = fibonacci_naive(index);
+    if (fib_cancelled())
+    {
+        free(bytes);
+        return (struct number){ NULL, 0 };
+    }
     return (struct number){ bytes, GENEROUS_BYTE_LIMIT };
 }
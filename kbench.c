@@ -0,0 +1,234 @@
+#include "kbench.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#endif
+
+// Microbenchmark of the limb kernels, one at a time, from 1 limb to past the
+// last level cache.
+//
+// Every (kernel, size) point runs in batches long enough to time, and keeps
+// the fastest of KBENCH_REPS batches. Prints CSV, with the machine figures
+// in a leading comment:
+//   kernel, limbs, bytes read and written per call, ns/limb, limbs/cycle,
+//   achieved bandwidth (GB/s), and that bandwidth over the measured peak
+// Cycles are TSC cycles. The peak is the best of a streaming read and a
+// memcpy far out of cache, so a kernel running from cache shows above 1:
+// read along a kernel's curve, the point where it drops under the roof is
+// where it becomes memory bound.
+
+#ifndef KBENCH_REPS
+#   define KBENCH_REPS 5
+#endif
+// shortest batch worth timing
+#ifndef KBENCH_BATCH_NS
+#   define KBENCH_BATCH_NS 2000000
+#endif
+// largest working set of a three-stream kernel, in multiples of the last
+// level cache
+#define LLC_FACTOR 2
+#define DEFAULT_LLC (32 << 20)
+
+static void run_memset(struct kbench_buffers const *b, size_t n)
+{
+    memset(b->out, 0, n * sizeof(uint64_t));
+}
+
+static void run_memcpy(struct kbench_buffers const *b, size_t n)
+{
+    memcpy(b->out, b->a, n * sizeof(uint64_t));
+}
+
+static struct kbench_kernel const kbench_libc[] = {
+    { "libc/memset", 1, run_memset },
+    { "libc/memcpy", 2, run_memcpy },
+    { NULL, 0, NULL },
+};
+
+static struct kbench_kernel const *const tables[] = {
+    kbench_fastsquaring,
+    kbench_linear,
+    kbench_libc,
+};
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// TSC ticks per ns, or 0 where there is none
+static double tsc_ghz(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    double const start = now_ns();
+    uint64_t const ticks = __rdtsc();
+    while (now_ns() - start < 50e6)
+    {
+    }
+    return (__rdtsc() - ticks) / (now_ns() - start);
+#else
+    return 0;
+#endif
+}
+
+// fastest ns per call of kernel over n limbs
+static double time_kernel(struct kbench_kernel const *kernel,
+                          struct kbench_buffers const *buffers, size_t n)
+{
+    // calibrate the batch
+    size_t iters = 1;
+    for (;;)
+    {
+        double const start = now_ns();
+        for (size_t i = 0; i < iters; ++i)
+        {
+            kernel->run(buffers, n);
+        }
+        if (now_ns() - start >= KBENCH_BATCH_NS || iters >= (size_t)1 << 40)
+        {
+            break;
+        }
+        iters *= 2;
+    }
+
+    double best = 0;
+    for (int rep = 0; rep < KBENCH_REPS; ++rep)
+    {
+        double const start = now_ns();
+        for (size_t i = 0; i < iters; ++i)
+        {
+            kernel->run(buffers, n);
+            __asm__ volatile("" ::: "memory");
+        }
+        double const elapsed = (now_ns() - start) / iters;
+        if (rep == 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// GB/s of streaming through, or copying, n limbs far out of cache
+static double measure_peak(struct kbench_buffers const *buffers, size_t n)
+{
+    double best = 0;
+    for (int rep = 0; rep < KBENCH_REPS; ++rep)
+    {
+        double start = now_ns();
+        uint64_t total = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            total += buffers->a[i];
+        }
+        __asm__ volatile("" :: "r"(total));
+        double gbps = n * sizeof(uint64_t) / (now_ns() - start);
+        if (gbps > best) { best = gbps; }
+
+        start = now_ns();
+        memcpy(buffers->out, buffers->b, n * sizeof(uint64_t));
+        gbps = 2 * n * sizeof(uint64_t) / (now_ns() - start);
+        if (gbps > best) { best = gbps; }
+    }
+    return best;
+}
+
+static uint64_t *alloc_limbs(size_t n)
+{
+    size_t const size = ((n + KBENCH_PAD) * sizeof(uint64_t) + 63) / 64 * 64;
+    uint64_t *p = aligned_alloc(64, size);
+    if (!p)
+    {
+        fprintf(stderr, "Failed to allocate %llu bytes.\n", (long long unsigned)size);
+        exit(EXIT_FAILURE);
+    }
+    // nonzero throughout, and touched before timing
+    uint64_t x = 0x243f6a8885a308d3ull ^ n;
+    for (size_t i = 0; i < n + KBENCH_PAD; ++i)
+    {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        p[i] = x | 1;
+    }
+    return p;
+}
+
+int main(int argc, char *argv[])
+{
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0)
+    {
+        llc = DEFAULT_LLC;
+    }
+    size_t max_limbs = LLC_FACTOR * (size_t)llc / (3 * sizeof(uint64_t));
+    char const *filter = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "k:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'k': filter = optarg; break;
+            case 'm': max_limbs = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-k kernel_substring] [-m max_limbs]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (max_limbs < 2)
+    {
+        max_limbs = 2;
+    }
+
+    struct kbench_buffers const buffers = {
+        .a = alloc_limbs(max_limbs),
+        .b = alloc_limbs(max_limbs),
+        .out = alloc_limbs(max_limbs),
+        .acc1 = alloc_limbs(max_limbs),
+        .acc2 = alloc_limbs(max_limbs),
+    };
+
+    double const ghz = tsc_ghz();
+    double const peak = measure_peak(&buffers, max_limbs);
+    printf("# llc_bytes=%ld tsc_ghz=%.3f peak_GBps=%.2f\n", llc, ghz, peak);
+    puts("kernel,limbs,bytes_per_call,ns_per_limb,limbs_per_cycle,GBps,peak_fraction");
+
+    for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); ++t)
+    {
+        for (struct kbench_kernel const *kernel = tables[t]; kernel->name; ++kernel)
+        {
+            if (filter && !strstr(kernel->name, filter))
+            {
+                continue;
+            }
+            // powers of two and the midpoints between them
+            for (size_t n = 1; n <= max_limbs; n = n < 2 ? n + 1 : (n & (n - 1)) ? (n / 3) * 4 : n + n / 2)
+            {
+                double const ns = time_kernel(kernel, &buffers, n);
+                double const bytes = (double)kernel->traffic * n * sizeof(uint64_t);
+                double const gbps = bytes / ns;
+                printf("%s,%llu,%.0f,%.4f,%.4f,%.3f,%.3f\n",
+                    kernel->name,
+                    (long long unsigned)n,
+                    bytes,
+                    ns / n,
+                    ghz > 0 ? n / (ns * ghz) : 0,
+                    gbps,
+                    gbps / peak);
+                fflush(stdout);
+            }
+        }
+    }
+
+    free(buffers.a);
+    free(buffers.b);
+    free(buffers.out);
+    free(buffers.acc1);
+    free(buffers.acc2);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+#ifndef KBENCH_H
+#define KBENCH_H
+
+#include "fib_base.h"
+
+// Limb kernels of the native impls, for the kbench microbenchmark.
+//
+// kbench_kernels.c is compiled once per impl in KBENCH_IMPL with that
+// impl's source included, so it can reach its static kernels; each build
+// exports a table of wrappers running one kernel over n 64-bit limbs.
+
+// operands and destinations, max_limbs + KBENCH_PAD limbs each
+#define KBENCH_PAD 8
+
+struct kbench_buffers {
+    uint64_t *a;
+    uint64_t *b;
+    uint64_t *out;
+    uint64_t *acc1;
+    uint64_t *acc2;
+};
+
+struct kbench_kernel {
+    char const *name;
+    unsigned traffic;               // limbs read plus limbs written, per limb
+    void (*run)(struct kbench_buffers const *buffers, size_t n);
+};
+
+// tables ending with a { NULL } entry
+extern struct kbench_kernel const kbench_fastsquaring[];
+extern struct kbench_kernel const kbench_linear[];
+
+#endif//KBENCH_H
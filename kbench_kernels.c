@@ -0,0 +1,62 @@
+#include "kbench.h"
+
+// arbitrary full-width multipliers
+#define SCALE1 0x9e3779b97f4a7c15ull
+#define SCALE2 0xc2b2ae3d27d4eb4full
+
+#if defined(KBENCH_fastsquaring)
+#   include "impl/fastsquaring.c"
+
+static void run_sum(struct kbench_buffers const *b, size_t n)
+{
+    // works on pairs of limbs
+    sum(b->out, b->a, b->b, (n + 1) & ~(size_t)1);
+}
+
+static void run_twice_sum(struct kbench_buffers const *b, size_t n)
+{
+    twice_sum(b->out, b->a, b->b, n);
+}
+
+static void run_scale_accum(struct kbench_buffers const *b, size_t n)
+{
+    scale_accum(b->acc1, b->a, SCALE1, n);
+}
+
+static void run_scale_accum_dup(struct kbench_buffers const *b, size_t n)
+{
+    scale_accum_dup(b->acc1, b->acc2, b->a, SCALE1, n);
+}
+
+static void run_scale_accum_twice(struct kbench_buffers const *b, size_t n)
+{
+    scale_accum_twice(b->acc1, b->acc2, b->a, SCALE1, SCALE2, n);
+}
+
+struct kbench_kernel const kbench_fastsquaring[] = {
+    { "fastsquaring/sum", 3, run_sum },
+    { "fastsquaring/twice_sum", 3, run_twice_sum },
+    { "fastsquaring/scale_accum", 3, run_scale_accum },
+    { "fastsquaring/scale_accum_dup", 5, run_scale_accum_dup },
+    { "fastsquaring/scale_accum_twice", 5, run_scale_accum_twice },
+    { NULL, 0, NULL },
+};
+
+#elif defined(KBENCH_linear)
+#   include "impl/linear.c"
+
+static void run_accumulate(struct kbench_buffers const *b, size_t n)
+{
+    // 128-bit digits
+    size_t const ndigits = (n + 1) / 2;
+    accumulate((DIGIT *)b->acc1, (DIGIT const *)b->a, ndigits);
+}
+
+struct kbench_kernel const kbench_linear[] = {
+    { "linear/accumulate", 3, run_accumulate },
+    { NULL, 0, NULL },
+};
+
+#else
+#   error "compile with -DKBENCH_<impl>"
+#endif
@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include "fib_base.h"
+#include "fib_registry.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// fib_base.h's debug logging, in the way of math.h's log()
+#undef log
+
+// In-process load generator: a stream of indices from a skewed distribution,
+// served by one impl on N threads, reported as throughput and latency
+// percentiles.
+//
+// Closed loop (the default): each thread issues its next request as soon as
+// the last one returns, so the numbers are those of a saturated server.
+// Open loop (-R rate): requests arrive as a Poisson process at the given
+// rate, whatever the impl keeps up with, each thread taking an equal share;
+// latency is measured from the scheduled arrival, so a backlog shows up in
+// the tail instead of silently lowering the offered load (coordinated
+// omission). Service time, from the actual start of a call, is reported
+// alongside. A duration (-d) bounds the arrivals; a backlog left at its end
+// is still served and counted.
+//
+// Indices are uniform over [0, max], Zipf (rank k is index k-1, so small
+// indices are the popular ones), log-uniform, or replayed from a file of
+// one index per line ('#' lines skipped), in order and cyclically.
+//
+// Latencies go into HDR-style histograms, one per thread, merged at the
+// end: 2^HIST_SUB_BITS linear buckets per power of two of nanoseconds, so
+// every percentile is exact to within 1%.
+
+#define DEFAULT_REQUESTS 10000
+#define DEFAULT_MAX_INDEX 100000
+#define DEFAULT_ZIPF 1.0
+#define DEFAULT_IMPL "gmp2"
+#define MAX_THREADS 256
+
+#define HIST_SUB_BITS 7
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_SIZE ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+enum distribution { UNIFORM, ZIPF, LOG_UNIFORM, TRACE };
+
+static char const *const distribution_names[] = { "uniform", "zipf", "loguniform", "trace" };
+
+struct histogram {
+    uint64_t counts[HIST_SIZE];
+    uint64_t total;
+    uint64_t max;
+    double sum;
+};
+
+// Zipf over ranks [1, n] with exponent s, by rejection-inversion (Hörmann
+// and Derflinger), which needs no table however large n is
+struct zipf {
+    double s;
+    double h_x1;
+    double h_n;
+    double s_div;
+    uint64_t n;
+};
+
+struct load {
+    struct fib_impl const *impl;
+    pthread_mutex_t *serial;        // impls with shared state, one call at a time
+    int verify;
+    enum distribution distribution;
+    uint64_t max_index;
+    struct zipf zipf;
+    uint64_t *trace;
+    size_t ntrace;
+    double rate;                    // requests/s, open loop; 0 for closed loop
+    unsigned nthreads;
+    uint64_t requests;              // 0: until the duration is up
+    double stop_at;                 // CLOCK_MONOTONIC seconds, 0 for none
+    double start;
+    atomic_uint_least64_t next;     // requests claimed so far
+};
+
+struct worker {
+    pthread_t thread;
+    unsigned id;
+    struct load *load;
+    uint64_t rng;
+    uint64_t done;
+    uint64_t wrong;
+    uint64_t bytes;
+    struct histogram latency;
+    struct histogram service;
+};
+
+// impls that are not reentrant (gmp memoises into static tables)
+static char const *const serial_impls[] = { "gmp" };
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double when)
+{
+    struct timespec t = { (time_t)when, (long)((when - (time_t)when) * 1e9) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL))
+    {
+    }
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// uniform in [0, 1)
+static double next_unit(uint64_t *state)
+{
+    return (next_random(state) >> 11) * 0x1p-53;
+}
+
+// log1p(x)/x and expm1(x)/x, accurate near 0
+static double helper1(double x)
+{
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x / 2;
+}
+
+static double helper2(double x)
+{
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x / 2;
+}
+
+// integral of x^-s, shifted to stay finite at s = 1, and its inverse
+static double zipf_h_integral(struct zipf const *z, double x)
+{
+    double const log_x = log(x);
+    return helper2((1 - z->s) * log_x) * log_x;
+}
+
+static double zipf_h_integral_inverse(struct zipf const *z, double x)
+{
+    double t = x * (1 - z->s);
+    if (t < -1)
+    {
+        t = -1;
+    }
+    return exp(helper1(t) * x);
+}
+
+static double zipf_h(struct zipf const *z, double x)
+{
+    return exp(-z->s * log(x));
+}
+
+static void zipf_init(struct zipf *z, uint64_t n, double s)
+{
+    z->s = s;
+    z->n = n;
+    z->h_x1 = zipf_h_integral(z, 1.5) - 1;
+    z->h_n = zipf_h_integral(z, n + 0.5);
+    z->s_div = 2 - zipf_h_integral_inverse(z, zipf_h_integral(z, 2.5) - zipf_h(z, 2));
+}
+
+static uint64_t zipf_next(struct zipf const *z, uint64_t *state)
+{
+    for (;;)
+    {
+        double const u = z->h_n + next_unit(state) * (z->h_x1 - z->h_n);
+        double const x = zipf_h_integral_inverse(z, u);
+        double k = floor(x + 0.5);
+        if (k < 1)
+        {
+            k = 1;
+        }
+        else if (k > z->n)
+        {
+            k = z->n;
+        }
+        if (k - x <= z->s_div || u >= zipf_h_integral(z, k + 0.5) - zipf_h(z, k))
+        {
+            return (uint64_t)k;
+        }
+    }
+}
+
+static uint64_t draw(struct load const *load, uint64_t *state, uint64_t request)
+{
+    switch (load->distribution)
+    {
+        case UNIFORM:
+            return next_random(state) % (load->max_index + 1);
+        case ZIPF:
+            return zipf_next(&load->zipf, state) - 1;
+        case LOG_UNIFORM:
+            return (uint64_t)exp2(next_unit(state) * log2((double)load->max_index + 2)) - 1;
+        case TRACE:
+            return load->trace[request % load->ntrace];
+    }
+    return 0;
+}
+
+static unsigned bucket_of(uint64_t ns)
+{
+    if (ns < HIST_SUB)
+    {
+        return ns;
+    }
+    unsigned const e = 63 - __builtin_clzll(ns);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + ((ns >> (e - HIST_SUB_BITS)) - HIST_SUB);
+}
+
+// highest value counted in the bucket, as HdrHistogram reports
+static uint64_t bucket_value(unsigned bucket)
+{
+    if (bucket < HIST_SUB)
+    {
+        return bucket;
+    }
+    unsigned const e = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t const low = (uint64_t)(HIST_SUB + bucket % HIST_SUB) << (e - HIST_SUB_BITS);
+    return low + ((uint64_t)1 << (e - HIST_SUB_BITS)) - 1;
+}
+
+static void histogram_add(struct histogram *h, double seconds)
+{
+    uint64_t const ns = seconds > 0 ? (uint64_t)(seconds * 1e9) : 0;
+    ++h->counts[bucket_of(ns)];
+    ++h->total;
+    h->sum += ns;
+    h->max = ns > h->max ? ns : h->max;
+}
+
+static void histogram_merge(struct histogram *into, struct histogram const *h)
+{
+    for (unsigned i = 0; i < HIST_SIZE; ++i)
+    {
+        into->counts[i] += h->counts[i];
+    }
+    into->total += h->total;
+    into->sum += h->sum;
+    into->max = h->max > into->max ? h->max : into->max;
+}
+
+// value at percentile p, in ns
+static uint64_t histogram_percentile(struct histogram const *h, double p)
+{
+    if (p >= 100)
+    {
+        return h->max;
+    }
+    uint64_t const rank = (uint64_t)ceil(p / 100 * h->total);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_SIZE; ++i)
+    {
+        seen += h->counts[i];
+        if (seen >= rank && seen)
+        {
+            uint64_t const value = bucket_value(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+static size_t significant_length(struct number n)
+{
+    uint8_t const *bytes = n.bytes;
+    size_t length = n.length;
+    while (length && !bytes[length - 1])
+    {
+        --length;
+    }
+    return length;
+}
+
+static int same_value(struct number a, struct number b)
+{
+    size_t const length = significant_length(a);
+    return length == significant_length(b) && !memcmp(a.bytes, b.bytes, length);
+}
+
+static void *run_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct load *load = w->load;
+    // every thread gets rate / nthreads: the sum is still Poisson at rate
+    double const rate = load->rate / load->nthreads;
+    double arrival = load->start;
+
+    for (;;)
+    {
+        uint64_t const request = atomic_fetch_add(&load->next, 1);
+        if (load->requests && request >= load->requests)
+        {
+            break;
+        }
+        uint64_t const index = draw(load, &w->rng, request);
+
+        if (rate > 0)
+        {
+            arrival += -log(1 - next_unit(&w->rng)) / rate;
+            if (load->stop_at && arrival > load->stop_at)
+            {
+                break;
+            }
+            sleep_until(arrival);
+        }
+        else if (load->stop_at && now() > load->stop_at)
+        {
+            break;
+        }
+
+        if (load->serial)
+        {
+            pthread_mutex_lock(load->serial);
+        }
+        double const start = now();
+        struct number const result = load->impl->fibonacci(index);
+        double const end = now();
+        if (load->serial)
+        {
+            pthread_mutex_unlock(load->serial);
+        }
+
+        histogram_add(&w->service, end - start);
+        histogram_add(&w->latency, end - (rate > 0 ? arrival : start));
+        ++w->done;
+        w->bytes += result.length;
+        if (!result.bytes)
+        {
+            ++w->wrong;
+        }
+        else if (load->verify)
+        {
+            struct number const expected = fib_registry[0].fibonacci(index);
+            w->wrong += !same_value(result, expected);
+            free(expected.bytes);
+        }
+        free(result.bytes);
+    }
+    return NULL;
+}
+
+static int read_trace(char const *path, struct load *load)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    size_t capacity = 1024;
+    load->trace = malloc(capacity * sizeof(*load->trace));
+    load->ntrace = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        char *end;
+        uint64_t const index = strtoull(line, &end, 0);
+        if (line[0] == '#' || end == line)
+        {
+            continue;
+        }
+        if (load->ntrace == capacity)
+        {
+            capacity *= 2;
+            load->trace = realloc(load->trace, capacity * sizeof(*load->trace));
+        }
+        load->trace[load->ntrace++] = index;
+    }
+    fclose(f);
+    if (!load->ntrace)
+    {
+        fprintf(stderr, "No indices in %s.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void report(struct load const *load, struct worker const *workers, double wall, double zipf_s)
+{
+    static struct histogram latency, service;
+    uint64_t done = 0, wrong = 0, bytes = 0;
+    for (unsigned i = 0; i < load->nthreads; ++i)
+    {
+        histogram_merge(&latency, &workers[i].latency);
+        histogram_merge(&service, &workers[i].service);
+        done += workers[i].done;
+        wrong += workers[i].wrong;
+        bytes += workers[i].bytes;
+    }
+
+    printf("# Impl:       %s, %u thread%s, %s loop\n",
+        load->impl->name, load->nthreads, load->nthreads == 1 ? "" : "s",
+        load->rate > 0 ? "open" : "closed");
+    if (load->distribution == TRACE)
+    {
+        printf("# Indices:    trace of %zu\n", load->ntrace);
+    }
+    else if (load->distribution == ZIPF)
+    {
+        printf("# Indices:    zipf(%.2f) over [0, %llu]\n", zipf_s, (long long unsigned)load->max_index);
+    }
+    else
+    {
+        printf("# Indices:    %s over [0, %llu]\n",
+            distribution_names[load->distribution], (long long unsigned)load->max_index);
+    }
+    printf("# Requests:   %llu (%llu wrong%s)\n",
+        (long long unsigned)done, (long long unsigned)wrong, load->verify ? "" : ", unverified");
+    printf("# Wall:       %.9fs\n", wall);
+    printf("# Throughput: %.1f req/s, %.1f MB/s", done / wall, bytes / wall * 1e-6);
+    if (load->rate > 0)
+    {
+        printf(" (offered %.1f req/s)", load->rate);
+    }
+    putchar('\n');
+    if (!done)
+    {
+        return;
+    }
+    printf("# Mean:       latency %.3fus, service %.3fus\n",
+        latency.sum / latency.total * 1e-3, service.sum / service.total * 1e-3);
+
+    static double const percentiles[] = { 50, 75, 90, 95, 99, 99.9, 99.99, 100 };
+    puts("#  Percentile  |  Latency (us)  |  Service (us)\n"
+         "# -------------+----------------+----------------");
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i)
+    {
+        printf("%14.3f | %14.3f | %14.3f\n", percentiles[i],
+            histogram_percentile(&latency, percentiles[i]) * 1e-3,
+            histogram_percentile(&service, percentiles[i]) * 1e-3);
+    }
+}
+
+static void usage(char const *argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [-i impl] [-t threads] [-n requests] [-d seconds] [-R rate]\n"
+        "       %*s [-D uniform|zipf|loguniform] [-m max_index] [-z exponent]\n"
+        "       %*s [-f trace_file] [-s seed] [-v]\n"
+        "Implementations:",
+        argv0, (int)strlen(argv0), "", (int)strlen(argv0), "");
+    fputc(' ', stderr);
+    fib_registry_list(stderr);
+    fputc('\n', stderr);
+}
+
+int main(int argc, char *argv[])
+{
+    struct load load = {
+        .distribution = UNIFORM,
+        .max_index = DEFAULT_MAX_INDEX,
+        .nthreads = 1,
+        .requests = DEFAULT_REQUESTS,
+    };
+    char const *impl = DEFAULT_IMPL;
+    char const *trace = NULL;
+    double duration = 0;
+    double zipf_s = DEFAULT_ZIPF;
+    uint64_t seed = 1;
+    int requests_given = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:t:n:d:R:D:m:z:f:s:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': impl = optarg; break;
+            case 't': load.nthreads = strtoul(optarg, NULL, 0); break;
+            case 'n': load.requests = strtoull(optarg, NULL, 0); requests_given = 1; break;
+            case 'd': duration = strtod(optarg, NULL); break;
+            case 'R': load.rate = strtod(optarg, NULL); break;
+            case 'm': load.max_index = strtoull(optarg, NULL, 0); break;
+            case 'z': zipf_s = strtod(optarg, NULL); break;
+            case 'f': trace = optarg; break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'v': load.verify = 1; break;
+            case 'D':
+                if (!strcmp(optarg, "uniform")) { load.distribution = UNIFORM; break; }
+                if (!strcmp(optarg, "zipf")) { load.distribution = ZIPF; break; }
+                if (!strcmp(optarg, "loguniform")) { load.distribution = LOG_UNIFORM; break; }
+                // fallthrough
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (load.nthreads == 0 || load.nthreads > MAX_THREADS || zipf_s <= 0)
+    {
+        fprintf(stderr, "threads must be between 1 and %d, and the Zipf exponent positive\n", MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+
+    load.impl = fib_registry_find(impl);
+    if (!load.impl)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    static pthread_mutex_t serial = PTHREAD_MUTEX_INITIALIZER;
+    for (size_t i = 0; i < sizeof(serial_impls) / sizeof(serial_impls[0]); ++i)
+    {
+        if (!strcmp(load.impl->name, serial_impls[i]) && load.nthreads > 1)
+        {
+            fprintf(stderr, "# %s is not reentrant, its calls are serialised\n", load.impl->name);
+            load.serial = &serial;
+        }
+    }
+
+    if (trace)
+    {
+        load.distribution = TRACE;
+        if (read_trace(trace, &load))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    if (load.distribution == ZIPF)
+    {
+        zipf_init(&load.zipf, load.max_index + 1, zipf_s);
+    }
+    // a duration alone runs until it is up
+    if (duration > 0 && !requests_given)
+    {
+        load.requests = 0;
+    }
+    if (!load.requests && duration <= 0)
+    {
+        fprintf(stderr, "Give a number of requests or a duration.\n");
+        return EXIT_FAILURE;
+    }
+
+    struct worker *workers = calloc(load.nthreads, sizeof(*workers));
+    load.start = now();
+    load.stop_at = duration > 0 ? load.start + duration : 0;
+    for (unsigned i = 0; i < load.nthreads; ++i)
+    {
+        workers[i].id = i;
+        workers[i].load = &load;
+        workers[i].rng = (seed + i) * 0x9E3779B97F4A7C15ull | 1;
+        if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]))
+        {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    uint64_t wrong = 0;
+    for (unsigned i = 0; i < load.nthreads; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        wrong += workers[i].wrong;
+    }
+    double const wall = now() - load.start;
+
+    report(&load, workers, wall, zipf_s);
+    free(workers);
+    free(load.trace);
+    return wrong ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include "fib_range.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef CLOCK
+#   define CLOCK CLOCK_PROCESS_CPUTIME_ID
+#endif
+
+static int parse_index(char const *arg, uint64_t *index)
+{
+    char *endptr;
+    *index = strtoull(arg, &endptr, 10);
+    if (*endptr != '\0')
+    {
+        fprintf(stderr, "Failed to interpret %s as an integer.\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+static int print_hex(uint64_t index, struct number value, void *ctx)
+{
+    uint8_t const *bytes = value.bytes;
+    size_t length = value.length;
+
+    printf("%20llu | ", (long long unsigned)index);
+    do
+    {
+        printf("%02x", bytes[--length]);
+    }
+    while (length);
+    putchar('\n');
+
+    (void)ctx;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t first, last;
+    if (argc < 3 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s first last [output.bin]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (parse_index(argv[1], &first) || parse_index(argv[2], &last))
+    {
+        return EXIT_FAILURE;
+    }
+    if (last < first)
+    {
+        fprintf(stderr, "Empty range: %s > %s\n", argv[1], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start_time;
+    clock_gettime(CLOCK, &start_time);
+
+    int status;
+    if (argc == 4)
+    {
+        status = fib_range_to_file(first, last, argv[3]);
+    }
+    else
+    {
+        status = fib_range(first, last, print_hex, NULL);
+    }
+
+    struct timespec end_time;
+    clock_gettime(CLOCK, &end_time);
+
+    if (status)
+    {
+        fprintf(stderr, "Failed to compute F(%s..%s).\n", argv[1], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    double const elapsed = (end_time.tv_sec - start_time.tv_sec)
+        + (end_time.tv_nsec - start_time.tv_nsec) * 1e-9;
+    fprintf(stderr, "# Runtime: %.9fs\n", elapsed);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+#include "fib_store.h"
+#include "fib_checksum.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gmp.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define ROUND_UP(x, align) (((x) + (align) - 1) / (align) * (align))
+
+static int write_all(int fd, void const *buf, size_t len, uint64_t offset)
+{
+    uint8_t const *bytes = buf;
+    while (len)
+    {
+        ssize_t written = pwrite(fd, bytes, len, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        bytes += written;
+        offset += written;
+        len -= written;
+    }
+    return 0;
+}
+
+static int generate(char const *path, unsigned count)
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", tmp_path);
+        return EXIT_FAILURE;
+    }
+
+    struct fib_store_header header = {
+        .magic = FIB_STORE_MAGIC,
+        .version = FIB_STORE_VERSION,
+        .count = count,
+        .byte_order = FIB_STORE_BYTE_ORDER,
+    };
+    struct fib_store_entry *entries = calloc(count, sizeof(*entries));
+
+    mpz_t value[3];
+    mpz_inits(value[0], value[1], value[2], NULL);
+
+    uint64_t offset = ROUND_UP(sizeof(header) + count * sizeof(*entries), FIB_STORE_ALIGN);
+    uint8_t *buf = NULL;
+    for (unsigned k = 0; k < count; ++k)
+    {
+        mpz_fib2_ui(value[1], value[0], 1ul << k);
+        mpz_add(value[2], value[1], value[0]);
+
+        // all three values are written back to back so one checksum covers them
+        uint64_t const begin = offset;
+        size_t const max_len = ROUND_UP(mpz_sizeinbase(value[2], 256), sizeof(uint64_t));
+        buf = realloc(buf, 3 * ROUND_UP(max_len, FIB_STORE_ALIGN));
+        size_t used = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            size_t const len = ROUND_UP(mpz_sizeinbase(value[i], 256), sizeof(uint64_t));
+            memset(&buf[used], 0, ROUND_UP(len, FIB_STORE_ALIGN));
+            mpz_export(&buf[used], NULL, -1, 1, 0, 0, value[i]);
+            entries[k].offset[i] = offset + used;
+            entries[k].length[i] = len;
+            used += i < 2 ? ROUND_UP(len, FIB_STORE_ALIGN) : len;
+        }
+        entries[k].checksum = fib_checksum(buf, used);
+        if (write_all(fd, buf, used, begin))
+        {
+            fprintf(stderr, "Failed to write file: %s\n", tmp_path);
+            return EXIT_FAILURE;
+        }
+        offset = ROUND_UP(begin + used, FIB_STORE_ALIGN);
+        fprintf(stderr, "# k = %2u: %llu B\n", k, (long long unsigned)used);
+    }
+
+    header.file_size = offset;
+    if (ftruncate(fd, offset)
+            || write_all(fd, &header, sizeof(header), 0)
+            || write_all(fd, entries, count * sizeof(*entries), sizeof(header))
+            || fsync(fd) || close(fd)
+            || rename(tmp_path, path))
+    {
+        fprintf(stderr, "Failed to write file: %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    free(buf);
+    free(entries);
+    mpz_clears(value[0], value[1], value[2], NULL);
+    return EXIT_SUCCESS;
+}
+
+static int verify(char const *path)
+{
+    struct fib_store store;
+    if (fib_store_open(&store, path))
+    {
+        fprintf(stderr, "Failed to open store: %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    int bad = fib_store_check(&store);
+    if (bad >= 0)
+    {
+        fprintf(stderr, "Checksum mismatch for k = %d.\n", bad);
+        fib_store_close(&store);
+        return EXIT_FAILURE;
+    }
+
+    mpz_t expected[3], stored;
+    mpz_inits(expected[0], expected[1], expected[2], stored, NULL);
+    int status = EXIT_SUCCESS;
+    for (unsigned k = 0; k < store.header->count && status == EXIT_SUCCESS; ++k)
+    {
+        mpz_fib2_ui(expected[1], expected[0], 1ul << k);
+        mpz_add(expected[2], expected[1], expected[0]);
+        for (int i = 0; i < 3; ++i)
+        {
+            struct number view = fib_store_value(&store, k, i - 1);
+            mpz_import(stored, view.length, -1, 1, 0, 0, view.bytes);
+            if (mpz_cmp(stored, expected[i]))
+            {
+                fprintf(stderr, "Wrong value for F(2^%u %+d).\n", k, i - 1);
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    if (status == EXIT_SUCCESS)
+    {
+        printf("# %s: %u entries OK\n", path, store.header->count);
+    }
+
+    mpz_clears(expected[0], expected[1], expected[2], stored, NULL);
+    fib_store_close(&store);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 4 && !strcmp(argv[1], "gen"))
+    {
+        char *endptr;
+        unsigned long count = strtoul(argv[3], &endptr, 10);
+        if (*endptr != '\0' || count == 0 || count > FIB_STORE_MAX_K)
+        {
+            fprintf(stderr, "Entry count must be between 1 and %d.\n", FIB_STORE_MAX_K);
+            return EXIT_FAILURE;
+        }
+        return generate(argv[2], count);
+    }
+    if (argc == 3 && !strcmp(argv[1], "verify"))
+    {
+        return verify(argv[2]);
+    }
+
+    fprintf(stderr,
+        "Usage: %s gen store.bin count\n"
+        "       %s verify store.bin\n",
+        argv[0], argv[0]
+    );
+    return EXIT_FAILURE;
+}
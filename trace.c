@@ -0,0 +1,51 @@
+#include "fib_base.h"
+#include "fib_trace.h"
+
+#include <stdio.h>
+
+// Traces one fibonacci() call and writes its phase spans as Chrome trace
+// JSON (see fib_trace.h); the impl is built with -DTRACE.
+//
+// A first, untraced call warms up the allocator, the helper threads and the
+// caches, so the trace shows the steady state.
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s index [output.json]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *endptr;
+    unsigned long long index = strtoull(argv[1], &endptr, 10);
+    if (*endptr != '\0')
+    {
+        fprintf(stderr, "Failed to interpret %s as an integer.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    free(fibonacci(index).bytes);
+    fib_trace_reset();
+    struct number const result = fibonacci(index);
+    if (!result.bytes)
+    {
+        fprintf(stderr, "F(%llu) failed\n", index);
+        return EXIT_FAILURE;
+    }
+    free(result.bytes);
+
+    if (fib_trace_dump(out) || (out != stdout && fclose(out)))
+    {
+        perror("fib_trace_dump");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
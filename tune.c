@@ -0,0 +1,300 @@
+#include <gmp.h>
+#include "fib_base.h"
+#include "fib_decimal.h"
+#include "fib_lockstep.h"
+#include "fib_workers.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the crossovers of fib_thresholds.h on this machine and prints
+// them as fib_tune.h (see `make tune`). Progress goes to stderr.
+//
+// Built with FIB_TUNE_PROGRAM: the thresholds are the variables below. For
+// each one, the two sides are timed against each other over growing sizes,
+// and the crossover is where the side above the threshold starts to win
+// (twice in a row, to ride out noise). A threshold whose sides cannot both
+// run here (parallel ones without a spare CPU) is left to its default.
+
+#define NEVER ((size_t)-1)
+#define NOT_MEASURED ((size_t)-2)
+// fib_decimal.h's default, which the tuning build does not see
+#define DEFAULT_LEAF_DIGITS 4096
+
+size_t fib_tune_parallel_limbs = NEVER;
+size_t fib_tune_parallel_gmp_limbs = NEVER;
+size_t fib_tune_lockstep_max_index = NEVER;
+size_t fib_tune_decimal_leaf_digits = DEFAULT_LEAF_DIGITS;
+size_t fib_tune_decimal_thread_digits = NEVER;
+
+// shortest measurement worth trusting, and how many are kept the best of
+#define TUNE_MIN_NS 20000000.0
+#define TUNE_REPS 3
+// consecutive wins that make a crossover
+#define TUNE_WINS 2
+
+struct number fib_impl_fastsquaring(uint64_t index);
+struct number fib_impl_gmp2(uint64_t index);
+
+// fibonacci_lockstep() hands indices above its threshold to this one
+struct number fibonacci(uint64_t index)
+{
+    return fib_impl_fastsquaring(index);
+}
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// best ns per call of run(arg), over batches of at least TUNE_MIN_NS
+static double measure(void (*run)(void *arg), void *arg)
+{
+    size_t iters = 1;
+    double best = 0;
+    for (int rep = 0; rep < TUNE_REPS;)
+    {
+        double const start = now_ns();
+        for (size_t i = 0; i < iters; ++i)
+        {
+            run(arg);
+        }
+        double const elapsed = now_ns() - start;
+        if (elapsed < TUNE_MIN_NS)
+        {
+            iters *= 2;
+            continue;
+        }
+        if (rep == 0 || elapsed / iters < best)
+        {
+            best = elapsed / iters;
+        }
+        ++rep;
+    }
+    return best;
+}
+
+struct call {
+    struct number (*fibonacci)(uint64_t index);
+    uint64_t index;
+};
+
+static void run_call(void *arg)
+{
+    struct call const *c = arg;
+    free(c->fibonacci(c->index).bytes);
+}
+
+// index whose result takes about limbs 64-bit limbs (F(n) has ~0.694n bits)
+static uint64_t index_for_limbs(size_t limbs)
+{
+    return (uint64_t)(limbs * 64 / 0.6942);
+}
+
+// Crossover of an impl's parallel steps: the whole call timed serial (the
+// threshold out of reach) against parallel for its top steps (the threshold
+// at half the result size).
+static size_t tune_parallel(char const *name, struct number (*fibonacci)(uint64_t),
+                            size_t *threshold, size_t max_limbs)
+{
+    unsigned wins = 0;
+    for (size_t limbs = 64; limbs <= max_limbs; limbs *= 2)
+    {
+        struct call c = { fibonacci, index_for_limbs(limbs) };
+        *threshold = NEVER;
+        double const serial = measure(run_call, &c);
+        *threshold = limbs / 2;
+        double const parallel = measure(run_call, &c);
+        fprintf(stderr, "# %s: %zu limbs, serial %.0f ns, parallel %.0f ns\n",
+            name, limbs, serial, parallel);
+
+        wins = parallel < serial ? wins + 1 : 0;
+        if (wins == TUNE_WINS)
+        {
+            return limbs / 4;
+        }
+    }
+    return NEVER;
+}
+
+struct lockstep_batch {
+    uint64_t *indices;
+    struct number *outputs;
+    size_t count;
+};
+
+static void run_lockstep(void *arg)
+{
+    struct lockstep_batch const *b = arg;
+    fibonacci_lockstep(b->indices, b->count, b->outputs);
+    for (size_t i = 0; i < b->count; ++i)
+    {
+        free(b->outputs[i].bytes);
+    }
+}
+
+static void run_each(void *arg)
+{
+    struct lockstep_batch const *b = arg;
+    for (size_t i = 0; i < b->count; ++i)
+    {
+        free(fib_impl_fastsquaring(b->indices[i]).bytes);
+    }
+}
+
+// Largest index the lockstep kernel handles faster, per result, than one
+// fastsquaring call each.
+static size_t tune_lockstep(void)
+{
+    size_t const count = 4 * fib_lockstep_lanes;
+    struct lockstep_batch b = {
+        malloc(count * sizeof(uint64_t)),
+        malloc(count * sizeof(struct number)),
+        count,
+    };
+
+    fib_tune_lockstep_max_index = NEVER;
+    size_t last_win = 0;
+    unsigned losses = 0;
+    for (uint64_t index = 16; index <= (1u << 20); index *= 2)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            b.indices[i] = index - (i % fib_lockstep_lanes);
+        }
+        double const lockstep = measure(run_lockstep, &b);
+        double const each = measure(run_each, &b);
+        fprintf(stderr, "# lockstep: F(%llu), lockstep %.0f ns, one by one %.0f ns\n",
+            (long long unsigned)index, lockstep / count, each / count);
+
+        if (lockstep < each)
+        {
+            last_win = index;
+            losses = 0;
+        }
+        else if (++losses == TUNE_WINS)
+        {
+            break;
+        }
+    }
+    free(b.indices);
+    free(b.outputs);
+    return last_win;
+}
+
+struct conversion {
+    struct number n;
+    unsigned nthreads;
+};
+
+static void run_decimal(void *arg)
+{
+    struct conversion const *c = arg;
+    size_t length;
+    free(fib_decimal(c->n, c->nthreads, &length));
+}
+
+// Leaf size converting fastest on one thread, on a value of ~10^6 digits.
+static size_t tune_decimal_leaf(void)
+{
+    struct conversion c = { fib_impl_fastsquaring(1u << 22), 1 };
+    size_t best_leaf = DEFAULT_LEAF_DIGITS;
+    double best = 0;
+    for (size_t leaf = 256; leaf <= (1u << 16); leaf *= 2)
+    {
+        fib_tune_decimal_leaf_digits = leaf;
+        double const t = measure(run_decimal, &c);
+        fprintf(stderr, "# decimal leaf: %zu digits, %.0f ns\n", leaf, t);
+        if (best == 0 || t < best)
+        {
+            best = t;
+            best_leaf = leaf;
+        }
+    }
+    free(c.n.bytes);
+    fib_tune_decimal_leaf_digits = best_leaf;
+    return best_leaf;
+}
+
+// Subtree size from which a second thread pays off.
+static size_t tune_decimal_threads(void)
+{
+    unsigned wins = 0;
+    for (uint64_t index = 1u << 16; index <= (1u << 26); index *= 2)
+    {
+        struct conversion c = { fib_impl_fastsquaring(index), 2 };
+        size_t const digits = (size_t)(index * 0.20899) + 1;   // log10(phi)
+
+        fib_tune_decimal_thread_digits = NEVER;
+        double const serial = measure(run_decimal, &c);
+        fib_tune_decimal_thread_digits = digits / 2;
+        double const threaded = measure(run_decimal, &c);
+        free(c.n.bytes);
+        fprintf(stderr, "# decimal threads: %zu digits, 1 thread %.0f ns, 2 threads %.0f ns\n",
+            digits, serial, threaded);
+
+        wins = threaded < serial ? wins + 1 : 0;
+        if (wins == TUNE_WINS)
+        {
+            return digits / 4;
+        }
+    }
+    return NEVER;
+}
+
+static void emit(char const *name, size_t value, char const *unit)
+{
+    if (value == NOT_MEASURED)
+    {
+        printf("// %s: not measured here, the default stays\n", name);
+    }
+    else if (value == NEVER)
+    {
+        printf("// %s: no crossover found, the default stays\n", name);
+    }
+    else
+    {
+        printf("#define %s %zu // %s\n", name, value, unit);
+    }
+}
+
+int main(void)
+{
+    long const ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    time_t const now = time(NULL);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&now));
+
+    size_t const leaf = tune_decimal_leaf();
+    size_t const lockstep = tune_lockstep();
+
+    size_t parallel = NOT_MEASURED, parallel_gmp = NOT_MEASURED, decimal_threads = NOT_MEASURED;
+    if (fib_workers_available())
+    {
+        parallel = tune_parallel("fastsquaring", fib_impl_fastsquaring, &fib_tune_parallel_limbs, 1u << 14);
+        parallel_gmp = tune_parallel("gmp2", fib_impl_gmp2, &fib_tune_parallel_gmp_limbs, 1u << 18);
+    }
+    else
+    {
+        fprintf(stderr, "# no helper threads, parallel thresholds not measured\n");
+    }
+    if (ncpu > 1)
+    {
+        decimal_threads = tune_decimal_threads();
+    }
+
+    printf("// generated by `make tune` (tune.c) on %s, %s, %ld CPUs\n", host, date, ncpu);
+    puts("#ifndef FIB_TUNE_H\n#define FIB_TUNE_H\n");
+    emit("FIB_DECIMAL_LEAF_DIGITS", leaf, "digits");
+    emit("FIB_LOCKSTEP_MAX_INDEX", lockstep ? lockstep : NEVER, "index");
+    emit("FIB_PARALLEL_LIMBS", parallel, "limbs");
+    emit("FIB_PARALLEL_GMP_LIMBS", parallel_gmp, "limbs");
+    emit("FIB_DECIMAL_THREAD_DIGITS", decimal_threads, "digits");
+    puts("\n#endif//FIB_TUNE_H");
+    return EXIT_SUCCESS;
+}